@@ -19,16 +19,20 @@
 #include <iostream>
 
 #include "ctello.h"
+#include "ctello_mission.h"
+#include "ctello_vision.h"
 #include "opencv2/core.hpp"
 #include "opencv2/highgui.hpp"
 #include "opencv2/imgcodecs.hpp"
 
-const char* const TELLO_STREAM_URL{"udp://0.0.0.0:11111"};
+// Wait for frames this long at most, so the window keeps responding.
+const std::chrono::milliseconds FRAME_TIMEOUT{100};
 
+using ctello::Frame;
+using ctello::FrameSource;
+using ctello::MissionRunner;
 using ctello::Tello;
-using cv::CAP_FFMPEG;
 using cv::imshow;
-using cv::VideoCapture;
 using cv::waitKey;
 
 int main()
@@ -40,38 +44,37 @@ int main()
     }
 
     tello.SendCommand("streamon");
-    while (!(tello.ReceiveResponse()))
-        ;
+    tello.WaitForResponse();
 
-    VideoCapture capture{TELLO_STREAM_URL, CAP_FFMPEG};
-    std::array<std::string, 8> commands{"takeoff", "flip l", "flip r", "flip f",
-                                        "flip b",  "stop",   "cw 360", "land"};
-    int index{0};
-    bool busy{false};
+    FrameSource frames;
+    frames.Start();
+    // Every command is sent as soon as the previous one is answered, while
+    // this thread keeps showing the stream.
+    MissionRunner mission{tello};
+    for (const auto& command : {"takeoff", "flip l", "flip r", "flip f",
+                                "flip b", "stop", "cw 360", "land"})
+    {
+        mission.Add(command);
+    }
+    mission.Start();
+    bool reported{false};
     while (true)
     {
-        // See surrounding.
-        cv::Mat frame;
-        capture >> frame;
+        // See surrounding, as it is now.
+        Frame frame;
+        const bool new_frame{frames.WaitForFrame(frame, FRAME_TIMEOUT)};
 
-        // Listen response
-        if (const auto response = tello.ReceiveResponse())
+        if (!reported && !mission.IsRunning())
         {
-            std::cout << "Tello: " << *response << std::endl;
-            busy = false;
+            mission.PrintReport(std::cout);
+            reported = true;
         }
 
-        // Act
-        if (!busy && index < commands.size())
+        // Show what the Tello sees
+        if (new_frame)
         {
-            const std::string command{commands[index++]};
-            tello.SendCommand(command);
-            std::cout << "Command: " << command << std::endl;
-            busy = true;
+            imshow("CTello Stream", frame.image);
         }
-
-        // Show what the Tello sees
-        imshow("CTello Stream", frame);
         if (waitKey(1) == 27)
         {
             break;
@@ -21,121 +21,82 @@
 #include <optional>
 
 #include "ctello.h"
+#include "ctello_controller.h"
+#include "ctello_detector.h"
+#include "ctello_vision.h"
 #include "opencv2/core.hpp"
 #include "opencv2/highgui.hpp"
 #include "opencv2/imgcodecs.hpp"
 #include "opencv4/opencv2/imgproc.hpp"
 
-// URL where the Tello sends its video stream to.
-const char* const TELLO_STREAM_URL{"udp://0.0.0.0:11111"};
-
 // The frame size is 720x960.
 // We assume the Tello's ray of vision to hit 360x480.
 const cv::Point2i TELLO_POSITION(480, 360);
 
-// Distance to consider target found.
-const int SQUARE_TARTET_DISTANCE{2500};
-
-// Amount of centimeters to move per pixel.
-const float CM_PER_PIXEL{0.3};
-
-// Maximum step to move.
-const int MIN_STEP{20};
-
-// Minimum step to move.
-const int MAX_STEP{60};
-
+// Pixels brighter than this are part of the target. Frames are only luma,
+// where white is 235.
+const uint8_t TARGET_THRESHOLD{230};
+
+// Smaller blobs aren't the target.
+const int MIN_TARGET_AREA{20};
+
+// Gains turning the pixel error into rc velocities. Half the frame away is
+// full speed.
+const ctello::PidGains HORIZONTAL_GAINS{0.2, 0.05, 0.02};
+const ctello::PidGains VERTICAL_GAINS{0.25, 0.05, 0.02};
+
+// Wait for frames this long at most, so the window keeps responding.
+const std::chrono::milliseconds FRAME_TIMEOUT{100};
+
+// Size of the window relative to the frame.
+const double DISPLAY_SCALE{0.75};
+
+using ctello::Blob;
+using ctello::BlobDetector;
+using ctello::BrightTargetDetector;
+using ctello::Frame;
+using ctello::FrameFormat;
+using ctello::FrameSource;
+using ctello::ImageView;
+using ctello::RcController;
+using ctello::Region;
+using ctello::TargetTracker;
 using ctello::Tello;
-using cv::CAP_FFMPEG;
+using cv::cvtColor;
 using cv::imshow;
 using cv::line;
 using cv::Mat;
 using cv::Point2i;
 using cv::resize;
 using cv::Size;
-using cv::Vec3b;
-using cv::VideoCapture;
 using cv::waitKey;
+namespace cmd = ctello::cmd;
 
 namespace
 {
-bool IsTarget(const uchar B, const uchar G, const uchar R)
+// The biggest light around where the tracker found it, so small reflections
+// don't pull the drone away.
+std::optional<Blob> FindTarget(TargetTracker& tracker,
+                               BlobDetector& blob_detector,
+                               const Mat& frame)
 {
     // Target is light.
-    return B > 250 && G > 250 && R > 250;
-}
-
-std::optional<Point2i> FindTarget(const Mat& frame)
-{
-    int max_row_count{0};
-    int max_row_index{0};
-    std::vector<int> cols_count(frame.cols, 0);
-    for (int i = 0; i < frame.rows; ++i)
-    {
-        int row_count{0};
-        for (int j = 0; j < frame.cols; ++j)
-        {
-            const auto& pixel = frame.at<Vec3b>(i, j);
-            const bool is_target = IsTarget(pixel[0], pixel[1], pixel[2]);
-            row_count += is_target;
-            cols_count[j] += is_target;
-        }
-        if (row_count > max_row_count)
-        {
-            max_row_count = row_count;
-            max_row_index = i;
-        }
-    }
-    const auto max_col_iter =
-        std::max_element(std::cbegin(cols_count), std::cend(cols_count));
-    const int max_col_index =
-        std::distance(std::cbegin(cols_count), max_col_iter);
-    if (max_col_index == 0 && max_row_index == 0)
+    const ImageView image{frame.data, frame.rows, frame.cols, frame.step,
+                          frame.channels()};
+    if (!tracker.Track(image))
     {
         return {};
     }
-    return Point2i(max_col_index, max_row_index);
-}
-
-std::pair<std::string, Point2i> Steer(const Point2i& position,
-                                      const Point2i& target,
-                                      const int square_target_distance,
-                                      const float cm_per_pixel,
-                                      const int min_step,
-                                      const int max_step)
-{
-    std::string command;
-    const Point2i velocity{target - position};
-    if (abs(velocity.x) > abs(velocity.y))
-    {
-        auto step = static_cast<int>(velocity.x * cm_per_pixel);
-        step = std::max(std::min(step, max_step), min_step);
-        if (velocity.x > 0)
-        {
-            command = "right " + std::to_string(step);
-        }
-        else
-        {
-            command = "left " + std::to_string(step);
-        }
-    }
-    else
+    const auto& blobs =
+        blob_detector.Find(image, tracker.GetSearchRegion(), MIN_TARGET_AREA);
+    if (blobs.empty())
     {
-        auto step = static_cast<int>(velocity.y * cm_per_pixel);
-        step = std::max(std::min(step, max_step), min_step);
-        if (velocity.y < 0)
-        {
-            command = "up " + std::to_string(step);
-        }
-        else
-        {
-            command = "down " + std::to_string(step);
-        }
+        return {};
     }
-    return {command, velocity};
+    return blobs.front();
 }
 
-void DrawMaxRowAndCol(Mat& image, const Point2i& target)
+void DrawTarget(Mat& image, const Point2i& target)
 {
     // Point(x, y) is (col, row)
     // Horizontal line
@@ -149,16 +110,22 @@ void DrawMaxRowAndCol(Mat& image, const Point2i& target)
     line(image, max_col_start, max_col_end, {0, 255, 0}, 2);
 }
 
-void DrawVelocity(Mat& image,
-                  const Point2i& tello_position,
-                  const Point2i& velocity)
+void DrawRegion(Mat& image, const Region& region, const double scale)
 {
-    arrowedLine(image, tello_position, tello_position + velocity, {0, 0, 255},
-                2);
+    const cv::Rect rect{static_cast<int>(region.col * scale),
+                        static_cast<int>(region.row * scale),
+                        static_cast<int>(region.cols * scale),
+                        static_cast<int>(region.rows * scale)};
+    cv::rectangle(image, rect, {255, 0, 0}, 1);
+}
+
+void DrawError(Mat& image, const Point2i& tello_position, const Point2i& error)
+{
+    arrowedLine(image, tello_position, tello_position + error, {0, 0, 255}, 2);
 }
 }  // namespace
 
-int main()
+int main(int argc, char** argv)
 {
     Tello tello{};
     if (!tello.Bind())
@@ -166,60 +133,98 @@ int main()
         return 0;
     }
 
-    tello.SendCommand("streamon");
-    while (!(tello.ReceiveResponse()))
-        ;
+    tello.SendCommand(cmd::StreamOn{});
+    tello.WaitForResponse();
 
-    VideoCapture capture{TELLO_STREAM_URL, CAP_FFMPEG};
+    // Decoding runs on its own thread and only the latest frame is kept, so
+    // the drone is steered with what it sees now, however slow this loop is.
+    // The target is just bright, so colour isn't even decoded.
+    FrameSource frames{FrameFormat::LUMA};
+    frames.Start();
 
     // Take-off first
-    tello.SendCommand("takeoff");
-    while (!(tello.ReceiveResponse()))
-        ;
+    tello.SendCommand(cmd::Takeoff{});
+    tello.WaitForResponse();
+
+    // The whole frame is only scanned, in bands by one thread per core, when
+    // the target is lost. Otherwise it's looked for around where it was.
+    BrightTargetDetector detector{TARGET_THRESHOLD, 0};
+    TargetTracker tracker{detector};
+    BlobDetector blob_detector{TARGET_THRESHOLD};
+
+    // An rc command per frame, so the drone flies smoothly towards the target
+    // and corrects as soon as a frame shows it somewhere else.
+    RcController controller{HORIZONTAL_GAINS, VERTICAL_GAINS};
+    if (argc > 1 && !controller.OpenTrace(argv[1]))
+    {
+        return 0;
+    }
+    bool hovering{true};
 
-    bool busy{false};
     while (true)
     {
         // See surrounding
-        Mat frame;
-        capture >> frame;
+        Frame latest;
+        if (!frames.WaitForFrame(latest, FRAME_TIMEOUT))
+        {
+            if (waitKey(1) == 27)
+            {
+                break;
+            }
+            continue;
+        }
+        Mat& frame{latest.image};
 
         // Listen response
         if (const auto response = tello.ReceiveResponse())
         {
             std::cout << "Tello: " << *response << std::endl;
-            busy = false;
         }
 
         // Act
-        if (const auto target = FindTarget(frame))
+        const auto blob = FindTarget(tracker, blob_detector, frame);
+        // The frame is shared with the decoder, so drawings go on a copy,
+        // in colour as the frame is only luma.
+        Mat scaled;
+        resize(frame, scaled, Size(), DISPLAY_SCALE, DISPLAY_SCALE);
+        Mat display;
+        cvtColor(scaled, display, cv::COLOR_GRAY2BGR);
+        DrawRegion(display, tracker.GetSearchRegion(), DISPLAY_SCALE);
+        if (blob)
         {
-            const auto steer =
-                Steer(TELLO_POSITION, *target, SQUARE_TARTET_DISTANCE,
-                      CM_PER_PIXEL, MIN_STEP, MAX_STEP);
-            const std::string command{steer.first};
-            if (!command.empty())
-            {
-                Point2i velocity{steer.second};
-                if (!busy)
-                {
-                    tello.SendCommand(command);
-                    std::cout << "Command: " << command << std::endl;
-                    busy = true;
-                }
-
-                // Show how Tello sees the target
-                DrawMaxRowAndCol(frame, *target);
-                DrawVelocity(frame, TELLO_POSITION, velocity);
-            }
+            // Towards the centre of the light
+            const Point2i target(static_cast<int>(blob->col),
+                                 static_cast<int>(blob->row));
+            DrawRegion(display, blob->bounds, DISPLAY_SCALE);
+            const Point2i error{target - TELLO_POSITION};
+            tello.SendCommand(
+                controller.Update(error.x, error.y, latest.time));
+            hovering = false;
+
+            // Show how Tello sees the target
+            DrawTarget(display, target * DISPLAY_SCALE);
+            DrawError(display, TELLO_POSITION * DISPLAY_SCALE,
+                      error * DISPLAY_SCALE);
+        }
+        else if (!hovering)
+        {
+            // Don't keep flying at the last velocities without a target.
+            tello.SendCommand(cmd::Rc{});
+            controller.Reset();
+            hovering = true;
         }
 
         // Show what the Tello sees
-        resize(frame, frame, Size(), 0.75, 0.75);
-        imshow("CTello Stream", frame);
+        imshow("CTello Stream", display);
         if (waitKey(1) == 27)
         {
             break;
         }
     }
+
+    tello.SendCommand(cmd::Rc{});
+
+    const auto stats = frames.GetStats();
+    std::cout << "Frames: " << stats.decoded << " decoded, " << stats.dropped
+              << " dropped" << std::endl;
 }
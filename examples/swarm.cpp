@@ -0,0 +1,96 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#include <iostream>
+
+#include "ctello_swarm.h"
+
+using ctello::Swarm;
+using ctello::TelloState;
+
+// Time to wait for all the drones to complete a manoeuvre.
+const std::chrono::milliseconds MANOEUVRE_TIMEOUT{15000};
+
+// Time to hover while showing the states.
+const std::chrono::seconds HOVER_TIME{5};
+
+namespace
+{
+// Sends a command to every drone and shows what each one answered.
+void Broadcast(Swarm& swarm, const std::string& command)
+{
+    swarm.Broadcast(command);
+    std::cout << "Command: " << command << std::endl;
+    const auto responses = swarm.WaitForResponses(MANOEUVRE_TIMEOUT);
+    for (std::size_t i = 0; i < responses.size(); ++i)
+    {
+        std::cout << "  Tello " << i << ": "
+                  << responses[i].value_or("timeout") << std::endl;
+    }
+}
+}  // namespace
+
+int main(const int argc, const char* const args[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: swarm IP[:PORT] ..." << std::endl;
+        return 1;
+    }
+
+    Swarm swarm;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string endpoint{args[i]};
+        const auto colon = endpoint.find(':');
+        if (colon == std::string::npos)
+        {
+            swarm.Add(endpoint);
+        }
+        else
+        {
+            swarm.Add(endpoint.substr(0, colon), endpoint.substr(colon + 1));
+        }
+    }
+    if (!swarm.Bind())
+    {
+        return 0;
+    }
+
+    Broadcast(swarm, "takeoff");
+
+    // Supervise all of them from this single thread.
+    const auto end = std::chrono::steady_clock::now() + HOVER_TIME;
+    TelloState state;
+    while (std::chrono::steady_clock::now() < end)
+    {
+        swarm.Poll(std::chrono::milliseconds{100});
+        for (std::size_t i = 0; i < swarm.Size(); ++i)
+        {
+            if (swarm.GetState(i, state))
+            {
+                std::cout << "Tello " << i << ": h " << state.h << " bat "
+                          << state.bat << std::endl;
+            }
+        }
+    }
+
+    Broadcast(swarm, "flip b");
+    Broadcast(swarm, "land");
+    return 0;
+}
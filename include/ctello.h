@@ -21,9 +21,29 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <optional>
-#include <vector>
+#include <thread>
 #include <string>
+#include <string_view>
+#include <vector>
+
+#include "ctello_commands.h"
+#include "ctello_log.h"
+#include "ctello_stats.h"
+#include "ctello_sync.h"
+#include "ctello_telemetry.h"
+
+namespace spdlog
+{
+class logger;
+}  // namespace spdlog
 
 // This is the server running in Tello, where we send commands to and we
 // receive responses from
@@ -44,17 +64,156 @@ const int LOCAL_CLIENT_COMMAND_PORT{9000};
 // We need to start a local UPD server to receive state updates.
 const int LOCAL_SERVER_STATE_PORT{8890};
 
+// After "streamon", Tello sends the H.264 video stream to this local port.
+const int LOCAL_SERVER_VIDEO_PORT{11111};
+
 namespace ctello
 {
+// Timeout value to block until data arrives, however long it takes.
+const std::chrono::milliseconds WAIT_FOREVER{-1};
+
+// Time to wait for the response of an asynchronous command. Manoeuvres like
+// "cw 360" or "flip b" are only answered once they are completed.
+const std::chrono::milliseconds DEFAULT_COMMAND_TIMEOUT{10000};
+
+// Every response and every state fits in this many bytes.
+const std::size_t MAX_RESPONSE_SIZE{32};
+const std::size_t MAX_STATE_SIZE{1024};
+
+// Outcome of an asynchronous command.
+struct Response
+{
+    enum class Status
+    {
+        OK,
+        ERROR,
+        // Answer to a read command ("battery?", "sn?", ...)
+        VALUE,
+        TIMEOUT,
+    };
+
+    Status status{Status::TIMEOUT};
+    // As received, empty on timeout
+    std::string text;
+    // Number of times the command was sent
+    int attempts{0};
+    // From the last attempt to the response
+    std::chrono::microseconds latency{0};
+};
+
+class TelemetryReplay;
+
 class Tello
 {
 public:
-    Tello();
+    // The default endpoints are the ones of a Tello acting as access point.
+    // Others can be given for Tellos in station mode ("ap s p") or for a
+    // simulator (see ctello-sim).
+    explicit Tello(const std::string& server_ip = TELLO_SERVER_IP,
+                   const std::string& server_command_port =
+                       TELLO_SERVER_COMMAND_PORT,
+                   int local_server_state_port = LOCAL_SERVER_STATE_PORT);
     ~Tello();
     bool Bind(int local_client_command_port = LOCAL_CLIENT_COMMAND_PORT);
-    bool SendCommand(const std::string& command);
+    bool SendCommand(std::string_view command);
+    // Sends a typed command (see ctello_commands.h), unless its values are
+    // out of range.
+    bool SendCommand(const cmd::Text& command);
     std::optional<std::string> ReceiveResponse();
+    // Receives the response into the given buffer, truncated to its size,
+    // and returns a view of it. Nothing is allocated, so it can be called
+    // every frame of a control loop.
+    std::optional<std::string_view> ReceiveResponse(char* buffer,
+                                                    std::size_t size);
     std::optional<std::string> GetState();
+    // Receives and parses a state into the given one, without allocating.
+    // Returns false if there wasn't any state to receive.
+    bool GetState(TelloState& state);
+
+    // Blocking versions of ReceiveResponse() and GetState(). They sleep in
+    // poll until a datagram arrives or the timeout expires, so waiting
+    // doesn't consume any CPU. Datagrams of the other kind aren't read
+    // meanwhile.
+    std::optional<std::string> WaitForResponse(
+        std::chrono::milliseconds timeout = WAIT_FOREVER);
+    std::optional<std::string_view> WaitForResponse(
+        char* buffer,
+        std::size_t size,
+        std::chrono::milliseconds timeout = WAIT_FOREVER);
+    std::optional<std::string> WaitForState(
+        std::chrono::milliseconds timeout = WAIT_FOREVER);
+    bool WaitForState(TelloState& state,
+                      std::chrono::milliseconds timeout = WAIT_FOREVER);
+
+    // File descriptor which becomes readable when there is a response or a
+    // state to receive. It can be added to an external poll/select/epoll
+    // loop, to call ReceiveResponse() and GetState() only when needed.
+    int GetPollFd() const;
+
+    // Starts a thread which receives and parses states as soon as they
+    // arrive, so they never pile up in the socket while the caller is busy.
+    // Meanwhile, GetState(TelloState&) and WaitForState(TelloState&) return
+    // the latest state without any syscall when there is nothing new, and
+    // the string versions of GetState() and WaitForState() return nothing.
+    // The poll fd is readable until the latest state is taken with
+    // GetState(TelloState&), or the history is emptied.
+    bool StartStateReceiver(std::size_t history_capacity = 256);
+    void StopStateReceiver();
+    // Copies the latest state received by the background receiver. It can
+    // be called from any thread and never blocks the receiver.
+    // Returns how many states have been received, so 0 means none yet.
+    uint64_t GetLatestState(TelloState& state) const;
+    // Pops the oldest state from the receiver history. The history is
+    // bounded, new states are dropped when it's full. Must be called from
+    // a single thread.
+    bool PopStateHistory(TelloState& state);
+
+    // Starts a background dispatcher for SendCommandAsync(). It's started
+    // on the first command otherwise. Call it before sharing the Tello with
+    // other threads, as it takes over the responses.
+    bool StartCommandDispatcher();
+    // Queues a command to be sent by the background dispatcher, starting
+    // it if needed. Tello handles one command at a time, so
+    // commands are sent in order, each one once the previous one has been
+    // answered or has timed out, and the next response is matched to the
+    // command in flight. A command is resent up to 'retries' times if it
+    // isn't answered within 'timeout'. Beware that a timed out manoeuvre
+    // might still be executed by the drone. "rc" isn't answered, so its
+    // future is ready, OK with no text, as soon as it's sent.
+    // While the dispatcher runs, it receives all the responses, so
+    // ReceiveResponse() and WaitForResponse() shouldn't be used.
+    std::future<Response> SendCommandAsync(
+        const std::string& command,
+        std::chrono::milliseconds timeout = DEFAULT_COMMAND_TIMEOUT,
+        int retries = 0);
+    // A typed command out of range is answered with an error right away.
+    std::future<Response> SendCommandAsync(
+        const cmd::Text& command,
+        std::chrono::milliseconds timeout = DEFAULT_COMMAND_TIMEOUT,
+        int retries = 0);
+    // Stops the dispatcher. Futures of commands still queued are broken.
+    void StopCommandDispatcher();
+
+    // Plays a telemetry file (see TelemetryRecorder) back instead of talking
+    // to a drone, to run control code through recorded flights. Call it
+    // instead of Bind(). States come from the recording at the given speed
+    // (see TelemetryReplay), and commands are only logged and answered with
+    // "ok", as responses aren't recorded. "rc" isn't answered, as usual. The
+    // state receiver isn't available while replaying.
+    bool OpenReplay(const std::string& path, double speed = 1);
+    // The replay and its virtual clock, or null if not replaying.
+    const TelemetryReplay* GetReplay() const;
+
+    // Snapshot of what has been sent and received so far: latency of the
+    // responses and timeouts per command verb, and how regularly states
+    // arrive. Intervals between states are taken when they are read, so
+    // they're only accurate with the state receiver. It can be called from
+    // any thread.
+    TelloStats GetStats() const;
+
+    // Level of the messages of this Tello only, which are named after its
+    // address when it isn't the default one (see SetLogLevel()).
+    void SetLogLevel(LogLevel level);
 
     Tello(const Tello&) = delete;
     Tello(const Tello&&) = delete;
@@ -64,12 +223,61 @@ public:
 private:
     void FindTello();
     void ShowTelloInfo();
+    std::optional<std::string_view> ReadResponse(char* buffer,
+                                                 std::size_t size);
+    // Into m_state_buffer
+    std::optional<std::string_view> ReadState();
+    // Sleeps until fd is readable, without reading anything.
+    bool WaitReadable(int fd, std::chrono::milliseconds timeout);
+    void ReceiveStates();
+    void DispatchCommands();
 
 private:
     int m_command_sockfd{0};
     int m_state_sockfd{0};
+    int m_epoll_fd{0};
     int m_local_client_command_port{LOCAL_CLIENT_COMMAND_PORT};
+    std::string m_server_ip;
+    std::string m_server_command_port;
+    int m_local_server_state_port{LOCAL_SERVER_STATE_PORT};
     sockaddr_storage m_tello_server_command_addr{};
+    // Datagrams are received into these, so steady state messages don't
+    // allocate.
+    std::array<char, MAX_RESPONSE_SIZE> m_response_buffer;
+    std::array<char, MAX_STATE_SIZE> m_state_buffer;
+    // Answers to replayed commands
+    std::deque<std::string> m_pending_responses;
+    std::unique_ptr<TelemetryReplay> m_replay;
+    std::unique_ptr<StatsCollector> m_stats;
+    std::shared_ptr<spdlog::logger> m_logger;
+
+    // Background state receiver
+    std::thread m_state_thread;
+    std::atomic<bool> m_state_receiver_running{false};
+    // Signals the receiver to stop
+    int m_state_stop_fd{-1};
+    // Signals waiters that a new state was received
+    int m_state_event_fd{-1};
+    SeqLock<TelloState> m_latest_state;
+    uint64_t m_last_state_version{0};
+    std::unique_ptr<SpscRing<TelloState>> m_state_history;
+
+    // Background command dispatcher
+    struct PendingCommand
+    {
+        std::string command;
+        std::chrono::milliseconds timeout;
+        int retries;
+        std::promise<Response> promise;
+    };
+    std::thread m_command_thread;
+    std::atomic<bool> m_command_dispatcher_running{false};
+    // Serializes starting and stopping the dispatcher
+    std::mutex m_command_dispatcher_mutex;
+    // Signals the dispatcher that there are new commands or it must stop
+    int m_command_wakeup_fd{-1};
+    std::mutex m_command_queue_mutex;
+    std::deque<PendingCommand> m_command_queue;
 };
 }  // namespace ctello
 
@@ -0,0 +1,81 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <chrono>
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace ctello
+{
+// Sends or receives many datagrams with a single syscall (sendmmsg and
+// recvmmsg). Headers, addresses and receive buffers are allocated once, up
+// front, so it can be reused without allocating.
+class DatagramBatch
+{
+public:
+    // Room for 'capacity' datagrams of up to 'datagram_size' bytes each.
+    DatagramBatch(std::size_t capacity, std::size_t datagram_size);
+
+    // Sending: Clear(), Add() as many as needed, and Send().
+    void Clear();
+    // The payload isn't copied, it must be alive until Send().
+    // Returns false if the batch is full, or the destination is neither
+    // IPv4 nor IPv6.
+    bool Add(const sockaddr_storage& dest, std::string_view payload);
+    // Returns the number of datagrams sent, or -1 on error.
+    int Send(int sockfd);
+
+    // Receives as many datagrams as there are, up to the capacity, without
+    // blocking. Returns how many were received, or -1 on error.
+    int Receive(int sockfd);
+
+    // Datagrams added or received
+    std::size_t Size() const;
+    std::size_t Capacity() const;
+    std::string_view Payload(std::size_t index) const;
+    const sockaddr_storage& Address(std::size_t index) const;
+    // When a datagram received arrived: as stamped by the kernel if the
+    // socket has SO_TIMESTAMPNS enabled, or else when it was received.
+    std::chrono::steady_clock::time_point Time(std::size_t index) const;
+
+    // The headers point into the members, so it can be moved but not copied.
+    DatagramBatch(const DatagramBatch&) = delete;
+    DatagramBatch(DatagramBatch&&) = default;
+    DatagramBatch& operator=(const DatagramBatch&) = delete;
+    DatagramBatch& operator=(DatagramBatch&&) = default;
+
+private:
+    std::size_t m_datagram_size;
+    std::size_t m_size{0};
+    std::vector<mmsghdr> m_headers;
+    std::vector<iovec> m_iovecs;
+    std::vector<sockaddr_storage> m_addrs;
+    // Of the datagrams added or received, which may be empty
+    std::vector<std::size_t> m_lengths;
+    std::vector<std::chrono::steady_clock::time_point> m_times;
+    // Ancillary data of every datagram received, for the timestamps
+    std::vector<char> m_control;
+    std::vector<char> m_buffer;
+};
+}  // namespace ctello
@@ -0,0 +1,349 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+// Typed commands of the Tello SDK 2.0, checked against the ranges of the SDK
+// when they are built:
+//
+//   tello.SendCommand(ctello::cmd::Up{50});
+//   tello.SendCommand(ctello::cmd::Rc{0, 0, 0, 30});
+//
+// Commands built in a constant expression with values out of range don't
+// compile:
+//
+//   constexpr ctello::cmd::Forward TOO_FAR{700};  // error
+//
+// Built at run time, they are invalid and Tello::SendCommand() refuses to
+// send them, instead of waiting for Tello to answer "error". They are
+// formatted into a buffer on the stack, so sending them doesn't allocate.
+namespace ctello::cmd
+{
+// "curve" with seven values fits in this many bytes, whatever they are.
+const std::size_t MAX_COMMAND_SIZE{96};
+
+// Text of a command, ready to send.
+class Text
+{
+public:
+    explicit Text(std::string_view verb, bool valid = true);
+
+    // Appends a space and the value.
+    Text& Append(int value);
+    Text& Append(char value);
+
+    std::string_view View() const;
+    // Whether the values are in range.
+    bool IsValid() const;
+
+private:
+    std::array<char, MAX_COMMAND_SIZE> m_buffer;
+    std::size_t m_size{0};
+    bool m_valid;
+};
+
+namespace detail
+{
+// Not constexpr on purpose: reaching it while building a command in a
+// constant expression stops the compilation there.
+inline bool ValueOutOfRange()
+{
+    return false;
+}
+
+constexpr bool InRange(const int value, const int min, const int max)
+{
+    return (value >= min && value <= max) || ValueOutOfRange();
+}
+
+// Tello refuses to go to points closer than 20 cm in every axis.
+constexpr bool FarEnough(const int x, const int y, const int z)
+{
+    return x < -20 || x > 20 || y < -20 || y > 20 || z < -20 || z > 20 ||
+           ValueOutOfRange();
+}
+
+// Command without values.
+template <typename Verb>
+class Plain
+{
+public:
+    constexpr Plain() = default;
+
+    operator Text() const
+    {
+        return Text{Verb::NAME};
+    }
+};
+
+// Command with a single integer from MIN to MAX.
+template <typename Verb, int MIN, int MAX>
+class Single
+{
+public:
+    constexpr explicit Single(const int value)
+        : m_value{value}, m_valid{InRange(value, MIN, MAX)}
+    {
+    }
+
+    constexpr int GetValue() const
+    {
+        return m_value;
+    }
+
+    constexpr bool IsValid() const
+    {
+        return m_valid;
+    }
+
+    operator Text() const
+    {
+        return Text{Verb::NAME, m_valid}.Append(m_value);
+    }
+
+private:
+    int m_value;
+    bool m_valid;
+};
+
+// clang-format off
+struct CommandVerb { static constexpr std::string_view NAME{"command"}; };
+struct TakeoffVerb { static constexpr std::string_view NAME{"takeoff"}; };
+struct LandVerb { static constexpr std::string_view NAME{"land"}; };
+struct StreamOnVerb { static constexpr std::string_view NAME{"streamon"}; };
+struct StreamOffVerb { static constexpr std::string_view NAME{"streamoff"}; };
+struct EmergencyVerb { static constexpr std::string_view NAME{"emergency"}; };
+struct StopVerb { static constexpr std::string_view NAME{"stop"}; };
+struct MonVerb { static constexpr std::string_view NAME{"mon"}; };
+struct MoffVerb { static constexpr std::string_view NAME{"moff"}; };
+struct UpVerb { static constexpr std::string_view NAME{"up"}; };
+struct DownVerb { static constexpr std::string_view NAME{"down"}; };
+struct LeftVerb { static constexpr std::string_view NAME{"left"}; };
+struct RightVerb { static constexpr std::string_view NAME{"right"}; };
+struct ForwardVerb { static constexpr std::string_view NAME{"forward"}; };
+struct BackVerb { static constexpr std::string_view NAME{"back"}; };
+struct CwVerb { static constexpr std::string_view NAME{"cw"}; };
+struct CcwVerb { static constexpr std::string_view NAME{"ccw"}; };
+struct SpeedVerb { static constexpr std::string_view NAME{"speed"}; };
+struct MdirectionVerb { static constexpr std::string_view NAME{"mdirection"}; };
+struct GetSpeedVerb { static constexpr std::string_view NAME{"speed?"}; };
+struct GetBatteryVerb { static constexpr std::string_view NAME{"battery?"}; };
+struct GetTimeVerb { static constexpr std::string_view NAME{"time?"}; };
+struct GetWifiVerb { static constexpr std::string_view NAME{"wifi?"}; };
+struct GetSdkVerb { static constexpr std::string_view NAME{"sdk?"}; };
+struct GetSnVerb { static constexpr std::string_view NAME{"sn?"}; };
+// clang-format on
+}  // namespace detail
+
+// Control commands
+using Command = detail::Plain<detail::CommandVerb>;
+using Takeoff = detail::Plain<detail::TakeoffVerb>;
+using Land = detail::Plain<detail::LandVerb>;
+using StreamOn = detail::Plain<detail::StreamOnVerb>;
+using StreamOff = detail::Plain<detail::StreamOffVerb>;
+using Emergency = detail::Plain<detail::EmergencyVerb>;
+using Stop = detail::Plain<detail::StopVerb>;
+// Distances in cm
+using Up = detail::Single<detail::UpVerb, 20, 500>;
+using Down = detail::Single<detail::DownVerb, 20, 500>;
+using Left = detail::Single<detail::LeftVerb, 20, 500>;
+using Right = detail::Single<detail::RightVerb, 20, 500>;
+using Forward = detail::Single<detail::ForwardVerb, 20, 500>;
+using Back = detail::Single<detail::BackVerb, 20, 500>;
+// Angles in degrees
+using Cw = detail::Single<detail::CwVerb, 1, 360>;
+using Ccw = detail::Single<detail::CcwVerb, 1, 360>;
+
+enum class Direction : char
+{
+    LEFT = 'l',
+    RIGHT = 'r',
+    FORWARD = 'f',
+    BACK = 'b',
+};
+
+class Flip
+{
+public:
+    constexpr explicit Flip(const Direction direction) : m_direction{direction}
+    {
+    }
+
+    operator Text() const;
+
+private:
+    Direction m_direction;
+};
+
+// Flies to (x, y, z) cm, relative to the current position, at speed cm/s.
+class Go
+{
+public:
+    constexpr Go(const int x, const int y, const int z, const int speed)
+        : m_x{x},
+          m_y{y},
+          m_z{z},
+          m_speed{speed},
+          m_valid{InRange(x) && InRange(y) && InRange(z) &&
+                  detail::FarEnough(x, y, z) &&
+                  detail::InRange(speed, 10, 100)}
+    {
+    }
+
+    constexpr bool IsValid() const
+    {
+        return m_valid;
+    }
+
+    operator Text() const;
+
+private:
+    static constexpr bool InRange(const int coordinate)
+    {
+        return detail::InRange(coordinate, -500, 500);
+    }
+
+private:
+    int m_x;
+    int m_y;
+    int m_z;
+    int m_speed;
+    bool m_valid;
+};
+
+// Flies through (x1, y1, z1) to (x2, y2, z2) cm, relative to the current
+// position, at speed cm/s. Whether the arc radius is between 0.5 and 10 m
+// is left to Tello.
+class Curve
+{
+public:
+    constexpr Curve(const int x1,
+                    const int y1,
+                    const int z1,
+                    const int x2,
+                    const int y2,
+                    const int z2,
+                    const int speed)
+        : m_points{x1, y1, z1, x2, y2, z2},
+          m_speed{speed},
+          m_valid{InRange(x1) && InRange(y1) && InRange(z1) && InRange(x2) &&
+                  InRange(y2) && InRange(z2) &&
+                  detail::FarEnough(x1, y1, z1) &&
+                  detail::FarEnough(x2, y2, z2) &&
+                  detail::InRange(speed, 10, 60)}
+    {
+    }
+
+    constexpr bool IsValid() const
+    {
+        return m_valid;
+    }
+
+    operator Text() const;
+
+private:
+    static constexpr bool InRange(const int coordinate)
+    {
+        return detail::InRange(coordinate, -500, 500);
+    }
+
+private:
+    std::array<int, 6> m_points;
+    int m_speed;
+    bool m_valid;
+};
+
+// Set commands
+using Speed = detail::Single<detail::SpeedVerb, 10, 100>;
+using Mon = detail::Plain<detail::MonVerb>;
+using Moff = detail::Plain<detail::MoffVerb>;
+// 0: downward, 1: forward, 2: both
+using Mdirection = detail::Single<detail::MdirectionVerb, 0, 2>;
+
+// Remote controller: left/right, forward/backward, up/down and yaw, from
+// -100 to 100. Tello doesn't answer it.
+class Rc
+{
+public:
+    constexpr Rc() = default;
+    constexpr Rc(const int left_right,
+                 const int forward_backward,
+                 const int up_down,
+                 const int yaw)
+        : m_left_right{left_right},
+          m_forward_backward{forward_backward},
+          m_up_down{up_down},
+          m_yaw{yaw},
+          m_valid{InRange(left_right) && InRange(forward_backward) &&
+                  InRange(up_down) && InRange(yaw)}
+    {
+    }
+
+    constexpr int GetLeftRight() const
+    {
+        return m_left_right;
+    }
+
+    constexpr int GetForwardBackward() const
+    {
+        return m_forward_backward;
+    }
+
+    constexpr int GetUpDown() const
+    {
+        return m_up_down;
+    }
+
+    constexpr int GetYaw() const
+    {
+        return m_yaw;
+    }
+
+    constexpr bool IsValid() const
+    {
+        return m_valid;
+    }
+
+    operator Text() const;
+
+private:
+    static constexpr bool InRange(const int channel)
+    {
+        return detail::InRange(channel, -100, 100);
+    }
+
+private:
+    int m_left_right{0};
+    int m_forward_backward{0};
+    int m_up_down{0};
+    int m_yaw{0};
+    bool m_valid{true};
+};
+
+// Read commands
+using GetSpeed = detail::Plain<detail::GetSpeedVerb>;
+using GetBattery = detail::Plain<detail::GetBatteryVerb>;
+using GetTime = detail::Plain<detail::GetTimeVerb>;
+using GetWifi = detail::Plain<detail::GetWifiVerb>;
+using GetSdk = detail::Plain<detail::GetSdkVerb>;
+using GetSn = detail::Plain<detail::GetSnVerb>;
+}  // namespace ctello::cmd
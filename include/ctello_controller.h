@@ -0,0 +1,108 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <string>
+
+#include "ctello_commands.h"
+
+namespace ctello
+{
+// Every channel of an "rc" command goes from -100 to 100.
+const int RC_LIMIT{100};
+
+struct PidGains
+{
+    double kp{0};
+    double ki{0};
+    double kd{0};
+};
+
+// Terms of the last output, to tune the gains.
+struct PidTerms
+{
+    double p{0};
+    double i{0};
+    double d{0};
+};
+
+// Proportional-integral-derivative controller. The output is clamped to the
+// limit and the integral term too, so it doesn't wind up while the output
+// saturates.
+class PidController
+{
+public:
+    explicit PidController(const PidGains& gains = {},
+                           double limit = RC_LIMIT);
+
+    // Output for the error measured seconds after the previous one. The
+    // first error after a reset has no integral nor derivative terms.
+    double Update(double error, double seconds);
+    void Reset();
+
+    void SetGains(const PidGains& gains);
+    const PidGains& GetGains() const;
+    const PidTerms& GetTerms() const;
+
+private:
+    PidGains m_gains;
+    double m_limit;
+    PidTerms m_terms;
+    double m_integral{0};
+    double m_previous_error{0};
+    bool m_has_previous{false};
+};
+
+// Keeps a target seen by the camera in the middle of the image, turning its
+// pixel error into the velocities of an "rc" command, one per frame: left and
+// right for the horizontal error and up and down for the vertical one.
+// Tello keeps flying at the last velocities it got, so it moves smoothly and
+// reacts as soon as a frame shows the target somewhere else, instead of
+// moving a fixed distance per command and waiting for its answer.
+class RcController
+{
+public:
+    RcController(const PidGains& horizontal, const PidGains& vertical);
+
+    // Errors are the target position minus the centre, in pixels (rows grow
+    // downwards), and time is when the frame was taken.
+    cmd::Rc Update(double error_x,
+                   double error_y,
+                   std::chrono::steady_clock::time_point time);
+    // Forgets the previous errors, e.g. when the target is lost.
+    void Reset();
+
+    // Also writes every error, PID terms and command as a CSV line to this
+    // file. Every update is logged at debug level anyway.
+    bool OpenTrace(const std::string& path);
+
+    PidController& GetHorizontal();
+    PidController& GetVertical();
+
+private:
+    PidController m_horizontal;
+    PidController m_vertical;
+    std::chrono::steady_clock::time_point m_start;
+    std::chrono::steady_clock::time_point m_previous_time;
+    bool m_has_previous{false};
+    std::ofstream m_trace;
+};
+}  // namespace ctello
@@ -0,0 +1,230 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "ctello_sync.h"
+
+namespace ctello
+{
+// Pixels of an 8-bit image with interleaved channels, like a cv::Mat. Not
+// owned.
+struct ImageView
+{
+    const uint8_t* data{nullptr};
+    int rows{0};
+    int cols{0};
+    // Bytes from the start of a row to the start of the next one
+    std::size_t step{0};
+    int channels{3};
+};
+
+// Instruction set used to scan the images, from slowest to fastest.
+enum class SimdKernel
+{
+    SCALAR,
+    SSSE3,
+    AVX2,
+    // The fastest one the CPU supports
+    BEST,
+};
+
+const char* ToString(SimdKernel kernel);
+
+// Rectangle of an image, in pixels.
+struct Region
+{
+    int row{0};
+    int col{0};
+    int rows{0};
+    int cols{0};
+};
+
+struct Target
+{
+    // Row and column with most target pixels
+    int row{0};
+    int col{0};
+    // Target pixels in the whole image
+    int pixels{0};
+};
+
+// Finds a light in BGR or luma images: the row and the column with most
+// pixels whose channels are all above the threshold. Rows and columns are
+// counted in a single pass, 16 or 32 pixels at a time when the CPU supports
+// it, and the image can be split in bands scanned by several threads.
+//
+// With limited range luma, as decoded from the Tello's stream, white is 235
+// and B, G and R above 250 is roughly Y above 230.
+class BrightTargetDetector
+{
+public:
+    // With 0 threads, there is one per core. Kernels the CPU doesn't
+    // support fall back to the fastest one it does.
+    explicit BrightTargetDetector(uint8_t threshold = 250,
+                                  int threads = 1,
+                                  SimdKernel kernel = SimdKernel::BEST);
+
+    std::optional<Target> Find(const ImageView& image);
+    // Only looks inside the region, clipped to the image. The target is
+    // still given in image coordinates.
+    std::optional<Target> Find(const ImageView& image, const Region& region);
+
+    // Target pixels per row and per column (of the region) found by the last
+    // Find()
+    const std::vector<uint32_t>& GetRowCounts() const;
+    const std::vector<uint32_t>& GetColCounts() const;
+
+    SimdKernel GetKernel() const;
+
+private:
+    void CountBand(const ImageView& image, int band, int first, int last);
+
+private:
+    uint8_t m_threshold;
+    int m_threads;
+    SimdKernel m_kernel;
+    // Scans the other bands, when there is more than one thread
+    std::unique_ptr<WorkerPool> m_pool;
+    std::vector<uint32_t> m_rows;
+    std::vector<uint32_t> m_cols;
+    // Column counts of every band, in 16 and 32 bits
+    std::vector<uint16_t> m_band_cols16;
+    std::vector<uint32_t> m_band_cols;
+};
+
+struct TrackerOptions
+{
+    // Half the side of the region searched around the predicted position
+    int search_radius{80};
+    // One row out of this many is scanned when looking for a lost target.
+    int coarse_stride{4};
+};
+
+struct TrackerStats
+{
+    // Frames where the target was found around its predicted position
+    uint64_t tracked{0};
+    // Frames where the whole image had to be scanned
+    uint64_t coarse_scans{0};
+    // Frames without target
+    uint64_t lost{0};
+};
+
+// Follows a target from frame to frame. Since it only moves a few pixels
+// between frames, it's looked for in a small region around where it should
+// be by now, at full resolution. Only when it isn't there, the whole image
+// is scanned skipping rows, and what is found is refined with a search
+// around it.
+class TargetTracker
+{
+public:
+    explicit TargetTracker(BrightTargetDetector& detector,
+                           const TrackerOptions& options = {});
+
+    std::optional<Target> Track(const ImageView& image);
+    // Forgets the target, the next frame is scanned whole.
+    void Reset();
+
+    // Where the last Track() looked for the target at full resolution,
+    // within the image
+    Region GetSearchRegion() const;
+    TrackerStats GetStats() const;
+
+private:
+    Region GetRegionAround(const ImageView& image, int row, int col) const;
+
+private:
+    BrightTargetDetector& m_detector;
+    TrackerOptions m_options;
+    std::optional<Target> m_last;
+    std::optional<Target> m_previous;
+    Region m_search_region;
+    TrackerStats m_stats;
+};
+
+struct Blob
+{
+    // Target pixels in it
+    int area{0};
+    Region bounds;
+    // Mean row and column of its pixels
+    double row{0};
+    double col{0};
+};
+
+// Finds every blob of 8-connected target pixels, with the same thresholds
+// as BrightTargetDetector. Rows are split in bands labelled by several
+// threads, as runs of target pixels joined with union-find, and the bands
+// are stitched together at the end.
+class BlobDetector
+{
+public:
+    // With 0 threads, there is one per core.
+    explicit BlobDetector(uint8_t threshold = 250,
+                          int threads = 1,
+                          SimdKernel kernel = SimdKernel::BEST);
+
+    // Blobs with at least the given area, biggest first. They stay valid
+    // until the next call.
+    const std::vector<Blob>& Find(const ImageView& image, int min_area = 1);
+    // Only looks inside the region, clipped to the image. Blobs are still
+    // given in image coordinates.
+    const std::vector<Blob>& Find(const ImageView& image,
+                                  const Region& region,
+                                  int min_area = 1);
+
+    SimdKernel GetKernel() const;
+
+private:
+    // Consecutive target pixels of a row
+    struct Run
+    {
+        int row;
+        int first;
+        int last;
+        // Union-find parent, the index of a run of the same blob
+        uint32_t parent;
+    };
+
+    struct Band
+    {
+        std::vector<Run> runs;
+        std::vector<uint8_t> mask;
+    };
+
+    void LabelBand(const ImageView& image, Band& band, int first, int last);
+
+private:
+    uint8_t m_threshold;
+    int m_threads;
+    SimdKernel m_kernel;
+    // Labels the other bands, when there is more than one thread
+    std::unique_ptr<WorkerPool> m_pool;
+    std::vector<Band> m_bands;
+    std::vector<Run> m_runs;
+    std::vector<int> m_blob_indices;
+    std::vector<Blob> m_blobs;
+};
+}  // namespace ctello
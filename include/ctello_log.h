@@ -0,0 +1,51 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#pragma once
+
+namespace ctello
+{
+enum class LogLevel
+{
+    TRACE,
+    DEBUG,
+    INFO,
+    WARN,
+    ERROR,
+    CRITICAL,
+    OFF,
+};
+
+// The library logs through its own loggers, never through spdlog's default
+// one, whose pattern and level are left alone. Messages are copied into a
+// lock-free ring and written to stdout by a background thread, so logging
+// never waits for the terminal. If the ring is full, messages are dropped
+// and counted instead.
+//
+// Messages below the level are discarded before being formatted. It starts
+// as SPDLOG_LEVEL, or "info", and applies to the library and to the Tellos
+// created from then on, whose level can also be set one by one (see
+// Tello::SetLogLevel()). Calls below CTELLO_LOG_LEVEL, a CMake option,
+// aren't even compiled.
+void SetLogLevel(LogLevel level);
+LogLevel GetLogLevel();
+
+// Waits until everything logged so far has been written, before writing to
+// the terminal directly, for instance.
+void FlushLog();
+}  // namespace ctello
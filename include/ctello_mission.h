@@ -0,0 +1,117 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ctello.h"
+
+namespace ctello
+{
+// What to do when a step times out or Tello answers with an error.
+enum class FailurePolicy
+{
+    // Stop the mission.
+    ABORT,
+    // Go on with the next step.
+    CONTINUE,
+    // Send "land" and stop the mission.
+    LAND,
+};
+
+struct MissionStep
+{
+    std::string command;
+    std::chrono::milliseconds timeout{DEFAULT_COMMAND_TIMEOUT};
+    int retries{0};
+    // Landing is the safe choice for a drone in the air.
+    FailurePolicy on_failure{FailurePolicy::LAND};
+};
+
+struct StepResult
+{
+    std::string command;
+    Response response;
+    // Since the start of the mission, until the step was dispatched and
+    // until it was answered (or timed out)
+    std::chrono::microseconds start{0};
+    std::chrono::microseconds end{0};
+};
+
+// Runs a sequence of commands in a background thread, dispatching each one
+// as soon as the previous one is answered. Commands go through
+// Tello::SendCommandAsync(), so ReceiveResponse() and WaitForResponse()
+// mustn't be used meanwhile, but states can be received as usual.
+class MissionRunner
+{
+public:
+    explicit MissionRunner(Tello& tello);
+    // Stops the mission, see Stop().
+    ~MissionRunner();
+
+    // Steps can only be added while not running.
+    void Add(const std::string& command);
+    void Add(const MissionStep& step);
+    // Adds the steps of a script with one command per line, optionally
+    // followed by options, and '#' comments:
+    //   takeoff
+    //   cw 360; timeout=20000; retries=1; on_failure=continue
+    // Returns false, without adding anything, if the script is malformed.
+    bool LoadScript(const std::string& path);
+
+    // Starts the command dispatcher on the calling thread, and the mission
+    // in the background. Returns false if it's already running.
+    bool Start();
+    // Stops once the step in flight is completed, and waits for it.
+    void Stop();
+    // Waits for the mission to end.
+    void Wait();
+    bool IsRunning() const;
+    // True if every step succeeded
+    bool Succeeded() const;
+
+    // Results of the steps completed so far
+    std::vector<StepResult> GetResults() const;
+    // Writes a table with the outcome and timing of every step.
+    void PrintReport(std::ostream& os) const;
+
+    MissionRunner(const MissionRunner&) = delete;
+    MissionRunner& operator=(const MissionRunner&) = delete;
+
+private:
+    void Run();
+
+private:
+    Tello& m_tello;
+    std::vector<MissionStep> m_steps;
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    std::atomic<bool> m_stop{false};
+    std::atomic<bool> m_succeeded{false};
+    mutable std::mutex m_results_mutex;
+    std::vector<StepResult> m_results;
+};
+}  // namespace ctello
@@ -0,0 +1,118 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "ctello_telemetry.h"
+
+namespace ctello
+{
+// Telemetry files are memory-mapped and made of:
+//
+//  - A header with the column names and types and the number of blocks.
+//  - Blocks of TELEMETRY_BLOCK_CAPACITY samples. Each block starts with an
+//    index (number of samples, first and last timestamps) followed by one
+//    column of timestamps and one column per state value, so a single
+//    value can be scanned without touching the others.
+//
+// Timestamps are steady clock nanoseconds, and values are stored as they
+// are in TelloState (4 bytes, int or float).
+const std::size_t TELEMETRY_BLOCK_CAPACITY{1024};
+
+// Appends states to a telemetry file. Appending is a handful of stores into
+// the mapping, the file grows a few blocks at a time.
+class TelemetryRecorder
+{
+public:
+    TelemetryRecorder() = default;
+    ~TelemetryRecorder();
+
+    // Creates (or truncates) the file.
+    bool Open(const std::string& path);
+    // Trims the file to the recorded samples and unmaps it.
+    void Close();
+    bool IsOpen() const;
+
+    // Timestamped now, or with the given steady clock time.
+    bool Append(const TelloState& state);
+    bool Append(const TelloState& state, std::chrono::nanoseconds timestamp);
+    std::size_t Size() const;
+
+    TelemetryRecorder(const TelemetryRecorder&) = delete;
+    TelemetryRecorder(const TelemetryRecorder&&) = delete;
+    TelemetryRecorder& operator=(const TelemetryRecorder&) = delete;
+    TelemetryRecorder& operator=(const TelemetryRecorder&&) = delete;
+
+private:
+    bool Grow();
+
+private:
+    int m_fd{-1};
+    char* m_data{nullptr};
+    std::size_t m_mapped_size{0};
+    std::size_t m_size{0};
+};
+
+// Reads a telemetry file, even one still being recorded or left behind by a
+// crash (as far as its header says it goes).
+class TelemetryReader
+{
+public:
+    TelemetryReader() = default;
+    ~TelemetryReader();
+
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const;
+
+    // Number of samples
+    std::size_t Size() const;
+    // For samples out of range, GetTimestamp() and GetValue() return 0 and
+    // Read() returns false.
+    std::chrono::nanoseconds GetTimestamp(std::size_t sample) const;
+    bool Read(std::size_t sample, TelloState& state) const;
+    // Reads a single value without decoding the rest of the state.
+    double GetValue(std::size_t sample,
+                    const StateField& field,
+                    int index = 0) const;
+    // Index of the first sample at or after the timestamp, or Size() if
+    // there is none. Whole blocks are skipped using their index.
+    std::size_t Find(std::chrono::nanoseconds timestamp) const;
+    // System clock time when the recording started
+    std::chrono::system_clock::time_point GetStartTime() const;
+
+    TelemetryReader(const TelemetryReader&) = delete;
+    TelemetryReader(const TelemetryReader&&) = delete;
+    TelemetryReader& operator=(const TelemetryReader&) = delete;
+    TelemetryReader& operator=(const TelemetryReader&&) = delete;
+
+private:
+    const char* Block(std::size_t block) const;
+
+private:
+    const char* m_data{nullptr};
+    std::size_t m_mapped_size{0};
+    std::size_t m_block_count{0};
+    std::size_t m_size{0};
+};
+}  // namespace ctello
@@ -0,0 +1,71 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+#include "ctello_recorder.h"
+#include "ctello_telemetry.h"
+
+namespace ctello
+{
+// Replay speed which doesn't wait at all between states.
+const double REPLAY_AS_FAST_AS_POSSIBLE{0};
+
+// Plays a telemetry file (see TelemetryRecorder) back on a virtual clock.
+// Every recorded state is delivered, in order, whatever the speed, so
+// replays are deterministic: only how long they take depends on the speed.
+class TelemetryReplay
+{
+public:
+    // 1 replays in real time, N N times faster, REPLAY_AS_FAST_AS_POSSIBLE
+    // without waiting.
+    bool Open(const std::string& path, double speed = 1);
+    // Starts again from the first state.
+    void Rewind();
+
+    // Copies the next state if it's due. Returns false otherwise.
+    bool Next(TelloState& state);
+    // Sleeps until the next state is due or the timeout expires (a negative
+    // timeout waits for as long as needed). Returns false if the timeout
+    // expired or the replay is finished.
+    bool WaitForNext(TelloState& state, std::chrono::milliseconds timeout);
+    bool IsFinished() const;
+
+    // Time of the recording since its first state. When replaying as fast
+    // as possible, it's the time of the last state delivered.
+    std::chrono::nanoseconds Now() const;
+    // States delivered and total
+    std::size_t Position() const;
+    std::size_t Size() const;
+
+private:
+    std::chrono::steady_clock::time_point DueTime(std::size_t sample) const;
+
+private:
+    TelemetryReader m_reader;
+    double m_speed{1};
+    std::size_t m_next{0};
+    std::chrono::steady_clock::time_point m_start;
+    std::chrono::nanoseconds m_first_timestamp{0};
+    std::chrono::nanoseconds m_last_timestamp{0};
+};
+}  // namespace ctello
@@ -0,0 +1,125 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#pragma once
+
+#include <netinet/in.h>
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ctello_telemetry.h"
+
+namespace ctello
+{
+struct SimulatorOptions
+{
+    // Where the simulated Tello listens for commands
+    std::string ip{"127.0.0.1"};
+    int command_port{8889};
+    // Port of the client where states are sent to
+    int state_port{8890};
+    // States per second, 0 disables them
+    double state_rate{10};
+
+    // Network impairments applied to every datagram the simulator sends.
+    // Each one is delayed by latency +/- jitter (uniformly distributed),
+    // dropped with probability 'loss' and delayed even more with
+    // probability 'reorder', so the following ones overtake it.
+    std::chrono::microseconds latency{0};
+    std::chrono::microseconds jitter{0};
+    double loss{0};
+    double reorder{0};
+    unsigned int seed{0};
+};
+
+struct SimulatorStats
+{
+    uint64_t commands{0};
+    uint64_t responses{0};
+    uint64_t states{0};
+    uint64_t dropped{0};
+    uint64_t reordered{0};
+};
+
+// Emulates the Tello SDK 2.0 on a UDP port: answers control, set and read
+// commands, keeps a rough flight state and streams it to the client once
+// it has entered SDK mode. States are sent from the command socket too, so
+// every simulator is identified by its address.
+class Simulator
+{
+public:
+    explicit Simulator(const SimulatorOptions& options = {});
+    ~Simulator();
+    bool Bind();
+    // Runs until Stop() is called.
+    void Run();
+    // Can be called from any thread or from a signal handler.
+    void Stop();
+    // Must not be called while running.
+    SimulatorStats GetStats() const;
+
+    Simulator(const Simulator&) = delete;
+    Simulator(const Simulator&&) = delete;
+    Simulator& operator=(const Simulator&) = delete;
+    Simulator& operator=(const Simulator&&) = delete;
+
+private:
+    struct Datagram
+    {
+        std::chrono::steady_clock::time_point due;
+        uint64_t order;
+        std::string payload;
+        sockaddr_in dest;
+
+        bool operator>(const Datagram& other) const
+        {
+            return due != other.due ? due > other.due : order > other.order;
+        }
+    };
+
+    std::optional<std::string> HandleCommand(const std::string& command);
+    void UpdateState(std::chrono::steady_clock::time_point now);
+    void Enqueue(std::string payload, const sockaddr_in& dest);
+    void SendDue(std::chrono::steady_clock::time_point now);
+
+private:
+    SimulatorOptions m_options;
+    int m_sockfd{-1};
+    int m_stop_fd{-1};
+    std::mt19937 m_random;
+    std::priority_queue<Datagram, std::vector<Datagram>, std::greater<>>
+        m_outgoing;
+    uint64_t m_order{0};
+    SimulatorStats m_stats;
+
+    // Simulated drone
+    bool m_sdk_mode{false};
+    bool m_flying{false};
+    int m_speed{10};
+    TelloState m_state;
+    sockaddr_in m_client_addr{};
+    std::chrono::steady_clock::time_point m_takeoff_time;
+    std::chrono::steady_clock::time_point m_power_on_time;
+};
+}  // namespace ctello
@@ -0,0 +1,172 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ctello
+{
+// Beyond this, the time between two states counts as a gap (Tello sends
+// them at about 10 Hz).
+const std::chrono::milliseconds STATE_GAP{300};
+
+struct LatencySummary
+{
+    uint64_t count{0};
+    std::chrono::microseconds min{0};
+    std::chrono::microseconds mean{0};
+    std::chrono::microseconds p50{0};
+    std::chrono::microseconds p90{0};
+    std::chrono::microseconds p99{0};
+    std::chrono::microseconds max{0};
+};
+
+// Histogram of latencies with logarithmic buckets, every power of two split
+// in 8 linear sub-buckets like HdrHistogram, so any latency up to a minute
+// is kept in a fixed array with less than 12.5% error. Recording is a few
+// bit operations and a relaxed atomic increment, so it can be done from
+// any thread while another one summarizes it.
+class LatencyHistogram
+{
+public:
+    static constexpr int SUB_BUCKET_BITS{3};
+    static constexpr int SUB_BUCKETS{1 << SUB_BUCKET_BITS};
+    // Longer latencies (about 67 s) are recorded as this long.
+    static constexpr int MAX_EXPONENT{26};
+    static constexpr int BUCKET_COUNT{(MAX_EXPONENT - SUB_BUCKET_BITS + 2) *
+                                      SUB_BUCKETS};
+
+    void Record(std::chrono::microseconds latency);
+    // Percentiles are the highest latency of their bucket.
+    LatencySummary Summarize() const;
+
+private:
+    static int GetBucket(uint64_t us);
+    static uint64_t GetBucketMax(int bucket);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> m_buckets{};
+    std::atomic<uint64_t> m_sum{0};
+};
+
+struct CommandStats
+{
+    // Command name, like "takeoff", "cw" or "battery?"
+    std::string verb;
+    uint64_t sent{0};
+    uint64_t ok{0};
+    uint64_t errors{0};
+    uint64_t values{0};
+    // Attempts not answered in time, resent or not
+    uint64_t timeouts{0};
+    // From sending to receiving the response
+    LatencySummary latency;
+};
+
+struct StateStats
+{
+    uint64_t received{0};
+    uint64_t malformed{0};
+    // Intervals longer than STATE_GAP
+    uint64_t gaps{0};
+    // Time between consecutive states
+    LatencySummary interval;
+    // Smoothed variation between consecutive intervals, as defined for
+    // RTP packets by RFC 3550
+    std::chrono::microseconds jitter{0};
+};
+
+struct TelloStats
+{
+    // Only the commands sent at least once
+    std::vector<CommandStats> commands;
+    // Responses received without a command waiting for them, e.g. after it
+    // timed out
+    uint64_t unexpected_responses{0};
+    StateStats states;
+};
+
+void PrintStats(std::ostream& os, const TelloStats& stats);
+
+// Counts what goes through a Tello: commands sent, their responses and
+// timeouts per command verb, and the arrival of states. Only one command
+// can wait for a response at a time, as Tello handles them one by one.
+// A command times out when it's reported so, or when the next one is sent
+// with no response after the timeout. Sent again sooner, it's just
+// replaced.
+// Everything is recorded with relaxed atomics into preallocated counters,
+// so it can be done from the sending and receiving threads at the same time
+// without locks nor allocations.
+class StatsCollector
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit StatsCollector(Clock::duration timeout);
+
+    void OnCommandSent(std::string_view command, Clock::time_point time);
+    void OnResponse(std::string_view response, Clock::time_point time);
+    // The command waiting for a response won't get it.
+    void OnTimeout();
+    // States must be reported from one thread at a time, malformed ones
+    // too.
+    void OnState(Clock::time_point time);
+    void OnMalformedState();
+
+    TelloStats GetStats() const;
+
+private:
+    struct VerbCounters
+    {
+        std::atomic<uint64_t> sent{0};
+        std::atomic<uint64_t> ok{0};
+        std::atomic<uint64_t> errors{0};
+        std::atomic<uint64_t> values{0};
+        std::atomic<uint64_t> timeouts{0};
+        LatencyHistogram latency;
+    };
+
+    // Every verb of the Tello SDK 2.0, and one for anything else.
+    static constexpr std::size_t VERB_COUNT{33};
+    static std::size_t FindVerb(std::string_view command);
+
+private:
+    Clock::duration m_timeout;
+    std::array<VerbCounters, VERB_COUNT> m_verbs;
+    // Verb of the command waiting for a response, -1 if none
+    std::atomic<int> m_waiting{-1};
+    std::atomic<Clock::rep> m_sent_at{0};
+    std::atomic<uint64_t> m_unexpected_responses{0};
+
+    std::atomic<uint64_t> m_states{0};
+    std::atomic<uint64_t> m_malformed_states{0};
+    std::atomic<uint64_t> m_state_gaps{0};
+    LatencyHistogram m_state_intervals;
+    Clock::time_point m_last_state;
+    Clock::duration m_last_interval{0};
+    std::atomic<double> m_jitter_us{0};
+};
+}  // namespace ctello
@@ -0,0 +1,113 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#pragma once
+
+#include <sys/socket.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ctello.h"
+#include "ctello_batch.h"
+#include "ctello_telemetry.h"
+
+namespace ctello
+{
+// Controls many Tellos in station mode ("ap s p") from a single thread.
+// All of them share one command socket and one state socket, and whatever
+// arrives is demultiplexed by the address of the sender.
+class Swarm
+{
+public:
+    explicit Swarm(int local_server_state_port = LOCAL_SERVER_STATE_PORT);
+    ~Swarm();
+
+    // Adds a drone and returns its index. Must be called before Bind().
+    int Add(const std::string& ip,
+            const std::string& command_port = TELLO_SERVER_COMMAND_PORT);
+    // Binds the sockets and enters SDK mode in every drone. Returns false if
+    // some drone didn't answer within the timeout.
+    bool Bind(int local_client_command_port = LOCAL_CLIENT_COMMAND_PORT,
+              std::chrono::milliseconds timeout = WAIT_FOREVER);
+    std::size_t Size() const;
+
+    bool SendCommand(int drone, const std::string& command);
+    // Sends the same command to every drone, all of them with a single
+    // syscall. Returns how many were sent.
+    int Broadcast(const std::string& command);
+
+    // Receives everything that has arrived, waiting up to the timeout if
+    // nothing has. Returns the number of datagrams received.
+    int Poll(std::chrono::milliseconds timeout = std::chrono::milliseconds{0});
+    // Pops the oldest response received from the given drone.
+    std::optional<std::string> ReceiveResponse(int drone);
+    // Copies the latest state of the given drone. Returns false if there
+    // isn't a new one since the last call.
+    bool GetState(int drone, TelloState& state);
+    // Waits until every drone has answered, typically after Broadcast().
+    // Drones which didn't answer within the timeout get no response.
+    std::vector<std::optional<std::string>> WaitForResponses(
+        std::chrono::milliseconds timeout = WAIT_FOREVER);
+
+    // File descriptor which becomes readable when Poll() has something to
+    // receive.
+    int GetPollFd() const;
+
+    Swarm(const Swarm&) = delete;
+    Swarm(const Swarm&&) = delete;
+    Swarm& operator=(const Swarm&) = delete;
+    Swarm& operator=(const Swarm&&) = delete;
+
+private:
+    struct Drone
+    {
+        std::string ip;
+        std::string command_port;
+        sockaddr_storage addr{};
+        std::deque<std::string> responses;
+        TelloState state;
+        bool new_state{false};
+    };
+
+    int FindDrone(const sockaddr_storage& addr) const;
+    int ReceiveResponses();
+    int ReceiveStates();
+
+private:
+    int m_command_sockfd{0};
+    int m_state_sockfd{0};
+    int m_epoll_fd{0};
+    int m_local_server_state_port{LOCAL_SERVER_STATE_PORT};
+    std::vector<Drone> m_drones;
+    // Drone indices by address (IP and port) and by IP alone, as some
+    // datagrams might not come from the command port.
+    std::unordered_map<uint64_t, int> m_drones_by_addr;
+    std::unordered_map<uint32_t, int> m_drones_by_ip;
+    // One command per drone, allocated in Bind()
+    DatagramBatch m_command_batch{0, 0};
+    // Everything received is drained in batches.
+    DatagramBatch m_response_batch;
+    DatagramBatch m_state_batch;
+};
+}  // namespace ctello
@@ -0,0 +1,428 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace ctello
+{
+// Size of a cache line, to keep producer and consumer data apart.
+const std::size_t CACHE_LINE_SIZE{64};
+
+// Sequence lock holding a single value. One thread stores, any number of
+// threads load without ever blocking the writer. Readers retry if the value
+// was overwritten while they were copying it.
+template <typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+    // Must only be called from one thread.
+    void Store(const T& value)
+    {
+        std::array<uint64_t, WORDS> words{};
+        std::memcpy(words.data(), &value, sizeof(T));
+        const uint64_t sequence{m_sequence.load(std::memory_order_relaxed)};
+        // Odd sequence means a store is in progress.
+        m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < WORDS; ++i)
+        {
+            m_words[i].store(words[i], std::memory_order_relaxed);
+        }
+        m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Copies the latest value. Returns how many values have been stored so
+    // far, so 0 means there is no value yet.
+    uint64_t Load(T& value) const
+    {
+        std::array<uint64_t, WORDS> words;
+        uint64_t before;
+        uint64_t after;
+        do
+        {
+            before = m_sequence.load(std::memory_order_acquire);
+            for (std::size_t i = 0; i < WORDS; ++i)
+            {
+                words[i] = m_words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = m_sequence.load(std::memory_order_relaxed);
+        } while (before != after || (before & 1));
+        std::memcpy(static_cast<void*>(&value), words.data(), sizeof(T));
+        return before / 2;
+    }
+
+private:
+    static constexpr std::size_t WORDS{(sizeof(T) + 7) / 8};
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_sequence{0};
+    std::array<std::atomic<uint64_t>, WORDS> m_words{};
+};
+
+// Bounded single-producer single-consumer queue. Push() and Pop() never
+// block; Push() fails when the queue is full.
+template <typename T>
+class SpscRing
+{
+public:
+    // The capacity is rounded up to a power of two.
+    explicit SpscRing(const std::size_t capacity)
+    {
+        std::size_t size{1};
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        m_buffer.resize(size);
+        m_mask = size - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    // Must only be called from the producer thread.
+    bool Push(const T& value)
+    {
+        const std::size_t head{m_head.load(std::memory_order_relaxed)};
+        if (head - m_tail.load(std::memory_order_acquire) == m_buffer.size())
+        {
+            return false;
+        }
+        m_buffer[head & m_mask] = value;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Must only be called from the consumer thread.
+    bool Pop(T& value)
+    {
+        const std::size_t tail{m_tail.load(std::memory_order_relaxed)};
+        if (tail == m_head.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        value = m_buffer[tail & m_mask];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::size_t Size() const
+    {
+        return m_head.load(std::memory_order_acquire) -
+               m_tail.load(std::memory_order_acquire);
+    }
+
+    std::size_t Capacity() const
+    {
+        return m_buffer.size();
+    }
+
+private:
+    std::vector<T> m_buffer;
+    std::size_t m_mask{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> m_head{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> m_tail{0};
+};
+
+// Bounded multi-producer single-consumer queue, after Dmitry Vyukov's
+// bounded MPMC queue. Every cell has a sequence number telling whether it's
+// free for the producer that claims it or ready for the consumer, so
+// neither Push() nor Pop() block or take locks. Push() fails when the queue
+// is full.
+template <typename T>
+class MpscRing
+{
+public:
+    // The capacity is rounded up to a power of two.
+    explicit MpscRing(const std::size_t capacity)
+    {
+        std::size_t size{1};
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        m_cells = std::make_unique<Cell[]>(size);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        m_mask = size - 1;
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    // Can be called from any thread.
+    bool Push(const T& value)
+    {
+        std::size_t head{m_head.load(std::memory_order_relaxed)};
+        while (true)
+        {
+            Cell& cell{m_cells[head & m_mask]};
+            const std::size_t sequence{
+                cell.sequence.load(std::memory_order_acquire)};
+            const auto lag = static_cast<std::ptrdiff_t>(sequence - head);
+            if (lag == 0)
+            {
+                // Free, unless another producer claims it first.
+                if (m_head.compare_exchange_weak(head, head + 1,
+                                                 std::memory_order_relaxed))
+                {
+                    cell.value = value;
+                    cell.sequence.store(head + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (lag < 0)
+            {
+                // Still holds the value of the previous lap.
+                return false;
+            }
+            else
+            {
+                head = m_head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Must only be called from the consumer thread.
+    bool Pop(T& value)
+    {
+        Cell& cell{m_cells[m_tail & m_mask]};
+        if (cell.sequence.load(std::memory_order_acquire) != m_tail + 1)
+        {
+            return false;
+        }
+        value = cell.value;
+        // Free for the producer of the next lap
+        cell.sequence.store(m_tail + m_mask + 1, std::memory_order_release);
+        ++m_tail;
+        return true;
+    }
+
+    std::size_t Capacity() const
+    {
+        return m_mask + 1;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence{0};
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    std::size_t m_mask{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> m_head{0};
+    alignas(CACHE_LINE_SIZE) std::size_t m_tail{0};
+};
+
+// Triple buffer handing the latest value from one producer to one consumer.
+// Neither of them ever blocks or copies: the producer fills the back buffer
+// and publishes it, replacing the previous value if the consumer didn't take
+// it (latest value wins), and the consumer takes the newest published value
+// as its front buffer.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Buffer to write the next value into. Must only be used from the
+    // producer thread.
+    T& Back()
+    {
+        return m_buffers[m_back];
+    }
+
+    // Publishes the back buffer, which swaps with the previously published
+    // one. Returns false if that one was dropped without being taken.
+    bool Publish()
+    {
+        const uint8_t previous{
+            m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel)};
+        m_back = previous & INDEX;
+        return !(previous & FRESH);
+    }
+
+    // Takes the latest published value into the front buffer. Returns false
+    // if nothing was published since the last time. Must only be called from
+    // the consumer thread.
+    bool Update()
+    {
+        if (!(m_middle.load(std::memory_order_relaxed) & FRESH))
+        {
+            return false;
+        }
+        const uint8_t previous{
+            m_middle.exchange(m_front, std::memory_order_acq_rel)};
+        m_front = previous & INDEX;
+        return true;
+    }
+
+    // Latest value taken by Update(). Must only be used from the consumer
+    // thread.
+    T& Front()
+    {
+        return m_buffers[m_front];
+    }
+
+private:
+    static constexpr uint8_t INDEX{3};
+    // Set while the middle buffer holds a value not taken yet
+    static constexpr uint8_t FRESH{4};
+
+    std::array<T, 3> m_buffers{};
+    uint8_t m_back{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<uint8_t> m_middle{1};
+    alignas(CACHE_LINE_SIZE) uint8_t m_front{2};
+};
+
+// Threads started once and woken up to run a job split in parts, such as
+// the bands of every frame, so no thread is created per job. The caller of
+// Run() works on the first part, and the threads of the pool on the rest.
+// Run() must not be called from several threads at once.
+class WorkerPool
+{
+public:
+    // Parts that can run at once, the caller's included
+    explicit WorkerPool(const int size)
+    {
+        for (int index = 1; index < size; ++index)
+        {
+            m_threads.emplace_back(&WorkerPool::Work, this, index);
+        }
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_stopping = true;
+        }
+        m_start.notify_all();
+        for (auto& thread : m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    int Size() const
+    {
+        return static_cast<int>(m_threads.size()) + 1;
+    }
+
+    // Calls job(part) for every part in [0, parts), with parts up to
+    // Size(), and returns once all of them are done. The job isn't copied.
+    template <typename Job>
+    void Run(const int parts, const Job& job)
+    {
+        Run(parts,
+            [](const void* const erased, const int part)
+            {
+                (*static_cast<const Job*>(erased))(part);
+            },
+            &job);
+    }
+
+private:
+    using Call = void (*)(const void*, int);
+
+    void Run(const int parts, const Call call, const void* const job)
+    {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_call = call;
+            m_job = job;
+            m_parts = parts;
+            m_pending = parts - 1;
+            ++m_generation;
+        }
+        m_start.notify_all();
+        call(job, 0);
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_done.wait(lock, [this] { return m_pending <= 0; });
+    }
+
+    void Work(const int index)
+    {
+        uint64_t generation{0};
+        std::unique_lock<std::mutex> lock{m_mutex};
+        while (true)
+        {
+            m_start.wait(lock,
+                         [this, generation]
+                         {
+                             return m_stopping || m_generation != generation;
+                         });
+            if (m_stopping)
+            {
+                return;
+            }
+            generation = m_generation;
+            // Not every job needs every thread.
+            if (index >= m_parts)
+            {
+                continue;
+            }
+            const Call call{m_call};
+            const void* const job{m_job};
+            lock.unlock();
+            call(job, index);
+            lock.lock();
+            if (--m_pending == 0)
+            {
+                m_done.notify_one();
+            }
+        }
+    }
+
+private:
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    // Bumped for every job, which the threads wait for
+    uint64_t m_generation{0};
+    Call m_call{nullptr};
+    const void* m_job{nullptr};
+    int m_parts{0};
+    int m_pending{0};
+    bool m_stopping{false};
+};
+}  // namespace ctello
@@ -0,0 +1,111 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace ctello
+{
+// Typed version of the state string Tello sends to LOCAL_SERVER_STATE_PORT:
+// "mid:-1;x:0;y:0;z:0;mpry:0,0,0;pitch:0;roll:0;yaw:0;vgx:0;vgy:0;vgz:0;
+//  templ:0;temph:0;tof:0;h:0;bat:0;baro:0.00;time:0;agx:0.00;agy:0.00;
+//  agz:0.00;"
+// Units are the ones used by the Tello SDK 2.0.
+struct TelloState
+{
+    // Mission pad ID (-1 if none detected), position (cm) and attitude
+    // (degrees) relative to it.
+    int mid{-1};
+    int x{0};
+    int y{0};
+    int z{0};
+    std::array<int, 3> mpry{};
+
+    // Attitude (degrees)
+    int pitch{0};
+    int roll{0};
+    int yaw{0};
+
+    // Speed (dm/s)
+    int vgx{0};
+    int vgy{0};
+    int vgz{0};
+
+    // Lowest and highest temperature (Celsius)
+    int templ{0};
+    int temph{0};
+
+    // Time of flight distance (cm) and height (cm)
+    int tof{0};
+    int h{0};
+
+    // Battery (%), barometer (m) and motors on time (s)
+    int bat{0};
+    float baro{0};
+    int time{0};
+
+    // Acceleration (0.001g)
+    float agx{0};
+    float agy{0};
+    float agz{0};
+};
+
+static_assert(std::is_trivially_copyable_v<TelloState>);
+
+enum class StateFieldType
+{
+    INT,
+    FLOAT,
+};
+
+// Describes where each field of the state string lives in TelloState, so
+// fields can be visited generically (printing, recording, ...).
+struct StateField
+{
+    std::string_view name;
+    StateFieldType type;
+    std::size_t offset;
+    // Number of consecutive values ("mpry" has 3)
+    int count;
+};
+
+const std::size_t STATE_FIELD_COUNT{21};
+// Number of values, counting each of "mpry" separately
+const std::size_t STATE_VALUE_COUNT{23};
+
+// Fields in the order Tello sends them.
+extern const std::array<StateField, STATE_FIELD_COUNT> STATE_FIELDS;
+
+// Parses a state string into the given state in a single pass, without
+// allocating. Unknown fields are ignored and missing ones left untouched.
+// Returns false, leaving the state untouched, if the text is malformed.
+bool ParseState(std::string_view text, TelloState& state);
+
+// Formats a state the way Tello sends it, so it can be parsed back.
+std::string FormatState(const TelloState& state);
+
+// Returns the index-th value of the given field as a double.
+double GetStateValue(const TelloState& state,
+                     const StateField& field,
+                     int index = 0);
+}  // namespace ctello
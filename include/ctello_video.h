@@ -0,0 +1,126 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "ctello.h"
+#include "ctello_sync.h"
+
+namespace ctello
+{
+// Tello splits every access unit (the NAL units of one frame) in datagrams
+// of this size, the last one being shorter.
+const std::size_t VIDEO_PACKET_SIZE{1460};
+
+// One complete access unit, straight from the receive buffers. It stays
+// valid until it's released.
+struct AccessUnit
+{
+    const uint8_t* data{nullptr};
+    std::size_t size{0};
+    // Number of access units completed before this one, dropped included
+    uint64_t sequence{0};
+    // When its last datagram arrived
+    std::chrono::steady_clock::time_point time;
+};
+
+struct VideoStats
+{
+    uint64_t packets{0};
+    uint64_t bytes{0};
+    uint64_t access_units{0};
+    // Dropped because the consumer didn't keep up
+    uint64_t dropped{0};
+    // Dropped because they didn't fit in a slot
+    uint64_t oversized{0};
+};
+
+// Receives the video stream in a background thread and reassembles it into
+// access units, in a ring of preallocated slots. Datagrams are received
+// straight into the slots and access units are handed out as views into
+// them, so the stream is never copied.
+//
+// There must be a single consumer. When all the slots are in use, new
+// access units are dropped (later frames can't be decoded without the
+// previous ones anyway, until the next key frame).
+class VideoReceiver
+{
+public:
+    explicit VideoReceiver(int local_port = LOCAL_SERVER_VIDEO_PORT,
+                           std::size_t slot_count = 8,
+                           std::size_t slot_size = 256 * 1024);
+    ~VideoReceiver();
+
+    bool Start();
+    void Stop();
+
+    // Takes the oldest access unit not taken yet, waiting up to the timeout
+    // for one. The previous one is released, if it wasn't already.
+    bool Acquire(AccessUnit& unit,
+                 std::chrono::milliseconds timeout = WAIT_FOREVER);
+    void Release();
+
+    // Readable when there are access units to acquire.
+    int GetPollFd() const;
+    // Can be called from any thread.
+    VideoStats GetStats() const;
+
+    VideoReceiver(const VideoReceiver&) = delete;
+    VideoReceiver(const VideoReceiver&&) = delete;
+    VideoReceiver& operator=(const VideoReceiver&) = delete;
+    VideoReceiver& operator=(const VideoReceiver&&) = delete;
+
+private:
+    struct Slot
+    {
+        std::vector<uint8_t> buffer;
+        std::size_t size{0};
+        uint64_t sequence{0};
+        std::chrono::steady_clock::time_point time;
+    };
+
+    void Receive();
+
+private:
+    int m_local_port;
+    int m_sockfd{-1};
+    int m_stop_fd{-1};
+    int m_event_fd{-1};
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    std::vector<Slot> m_slots;
+    // The producer fills m_slots[m_head % size], the consumer reads
+    // m_slots[m_tail % size].
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_head{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> m_tail{0};
+    bool m_acquired{false};
+
+    std::atomic<uint64_t> m_packets{0};
+    std::atomic<uint64_t> m_bytes{0};
+    std::atomic<uint64_t> m_access_units{0};
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_oversized{0};
+};
+}  // namespace ctello
@@ -0,0 +1,158 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "ctello.h"
+#include "ctello_sync.h"
+#include "ctello_video.h"
+#include "opencv2/core.hpp"
+
+struct AVCodecContext;
+struct AVCodecParserContext;
+struct AVFrame;
+struct AVPacket;
+
+namespace ctello
+{
+// URL where the Tello sends its video stream to, for FFmpeg.
+const char* const TELLO_STREAM_URL{"udp://0.0.0.0:11111"};
+
+// What the frames are decoded into.
+enum class FrameFormat
+{
+    // 3 channels, decoded by FFmpeg and converted by OpenCV
+    BGR,
+    // Just the Y plane, straight from the decoder without converting or
+    // copying anything. It's shared with the decoder, which may still need
+    // it for the next pictures, so it must not be written.
+    LUMA,
+};
+
+struct Frame
+{
+    cv::Mat image;
+    // Keeps the decoded picture alive while the image points to it
+    std::shared_ptr<const void> picture;
+    // Number of frames decoded before this one, dropped included
+    uint64_t sequence{0};
+    // When it was decoded
+    std::chrono::steady_clock::time_point time;
+};
+
+struct FrameStats
+{
+    uint64_t decoded{0};
+    uint64_t delivered{0};
+    // Replaced by a newer frame before being taken
+    uint64_t dropped{0};
+};
+
+// Decodes the H.264 access units given by VideoReceiver with libavcodec,
+// keeping only the luma of the pictures.
+class H264Decoder
+{
+public:
+    H264Decoder() = default;
+    ~H264Decoder();
+
+    bool Open();
+    void Close();
+
+    // Returns true if the access unit completes a picture, whose Y plane is
+    // then put in the frame. Until the first key frame, there is none.
+    bool Decode(const uint8_t* data, std::size_t size, Frame& frame);
+
+    H264Decoder(const H264Decoder&) = delete;
+    H264Decoder(const H264Decoder&&) = delete;
+    H264Decoder& operator=(const H264Decoder&) = delete;
+    H264Decoder& operator=(const H264Decoder&&) = delete;
+
+private:
+    AVCodecContext* m_context{nullptr};
+    AVCodecParserContext* m_parser{nullptr};
+    AVPacket* m_packet{nullptr};
+    AVFrame* m_picture{nullptr};
+};
+
+// Decodes the video stream in a background thread and always hands out the
+// latest frame, dropping the ones the consumer didn't keep up with. Frames
+// never queue up, so whoever acts on them sees the drone as it is now, not
+// as it was a few seconds ago.
+//
+// Frames are decoded into a triple buffer, so there must be a single
+// consumer and the frame it gets stays valid until its next call.
+class FrameSource
+{
+public:
+    // BGR frames from the given URL
+    explicit FrameSource(const std::string& url = TELLO_STREAM_URL);
+    // LUMA frames are decoded from what arrives at LOCAL_SERVER_VIDEO_PORT,
+    // BGR ones from TELLO_STREAM_URL.
+    explicit FrameSource(FrameFormat format);
+    ~FrameSource();
+
+    bool Start();
+    void Stop();
+
+    // Waits up to the timeout for a frame newer than the previous one. The
+    // image shares its data with the source until the next call, clone() it
+    // to keep it longer.
+    bool WaitForFrame(Frame& frame,
+                      std::chrono::milliseconds timeout = WAIT_FOREVER);
+
+    // Readable when there is a new frame.
+    int GetPollFd() const;
+    // Can be called from any thread.
+    FrameStats GetStats() const;
+
+    FrameSource(const FrameSource&) = delete;
+    FrameSource(const FrameSource&&) = delete;
+    FrameSource& operator=(const FrameSource&) = delete;
+    FrameSource& operator=(const FrameSource&&) = delete;
+
+private:
+    void DecodeBgr();
+    void DecodeLuma();
+    // Hands the back buffer, just decoded, to the consumer.
+    void Publish();
+
+private:
+    FrameFormat m_format{FrameFormat::BGR};
+    std::string m_url;
+    std::unique_ptr<VideoReceiver> m_receiver;
+    std::unique_ptr<H264Decoder> m_decoder;
+    int m_event_fd{-1};
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    std::atomic<bool> m_stop{false};
+    TripleBuffer<Frame> m_frames;
+
+    std::atomic<uint64_t> m_decoded{0};
+    std::atomic<uint64_t> m_delivered{0};
+    std::atomic<uint64_t> m_dropped{0};
+};
+}  // namespace ctello
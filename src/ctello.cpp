@@ -25,152 +25,109 @@
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <array>
 #include <sstream>
 
+#include "ctello_batch.h"
+#include "ctello_internal.h"
+#include "ctello_replay.h"
 #include "spdlog/spdlog.h"
 
-const char* const LOG_PATTERN = "[%D %T] [ctello] [%^%l%$] %v";
+using ResponseStatus = ctello::Response::Status;
+
+// Time to wait for Tello to answer before we send "command" again.
+const std::chrono::milliseconds FIND_TELLO_TIMEOUT{1000};
+
+// Time to wait for Tello to answer a read command.
+const std::chrono::milliseconds QUERY_TIMEOUT{1000};
+
+// States received per syscall by the state receiver
+const std::size_t STATE_BATCH_SIZE{16};
 
 namespace
 {
-// Reads the spdlog level from the given environment variable name.
-spdlog::level::level_enum GetLogLevelFromEnv(const std::string& var_name)
+// Some responses and states contain trailing white spaces.
+std::string_view TrimRight(const std::string_view text)
 {
-    // clang-format off
-    std::unordered_map<std::string, spdlog::level::level_enum> name_to_enum = {
-        {"trace", spdlog::level::trace},
-        {"debug", spdlog::level::debug},
-        {"info", spdlog::level::info},
-        {"warn", spdlog::level::warn},
-        {"error", spdlog::level::err},
-        {"critical", spdlog::level::critical},
-        {"off", spdlog::level::off}
-    };
-    // clang-format on
-    const char* const name_c_str = std::getenv(var_name.c_str());
-    if (!name_c_str)
-    {
-        // Info is the default
-        return spdlog::level::info;
-    }
-    const std::string name{name_c_str};
-    return name_to_enum[name];
+    const std::size_t end{text.find_last_not_of(" \n\r\t")};
+    return text.substr(0, end == std::string_view::npos ? 0 : end + 1);
 }
 
-// Binds the given socket file descriptor ot the given port.
-// Returns whether it succeeds or not and the error message.
-std::pair<bool, std::string> BindSocketToPort(const int sockfd, const int port)
+// Classifies a response according to the Tello SDK 2.0.
+ResponseStatus GetResponseStatus(const std::string_view response)
 {
-    sockaddr_in listen_addr{};
-    // htons converts from host byte order to network byte order.
-    listen_addr.sin_port = htons(port);
-    listen_addr.sin_addr.s_addr = INADDR_ANY;
-    listen_addr.sin_family = AF_INET;
-    int result = bind(sockfd, reinterpret_cast<sockaddr*>(&listen_addr),
-                      sizeof(listen_addr));
-
-    if (result == -1)
+    if (response == "ok")
     {
-        std::stringstream ss;
-        ss << "bind to " << port << ": " << errno;
-        ss << " (" << strerror(errno) << ")";
-        return {false, ss.str()};
+        return ResponseStatus::OK;
     }
-
-    return {true, ""};
-}
-
-// Finds the socket address given an ip and a port.
-// Returns whether it succeeds or not and the error message.
-std::pair<bool, std::string> FindSocketAddr(const char* const ip,
-                                            const char* const port,
-                                            sockaddr_storage* const addr)
-{
-    addrinfo* result_list{nullptr};
-    addrinfo hints{};
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_DGRAM;
-    int result = getaddrinfo(ip, port, &hints, &result_list);
-
-    if (result)
+    if (response.rfind("error", 0) == 0)
     {
-        std::stringstream ss;
-        ss << "getaddrinfo: " << result;
-        ss << " (" << gai_strerror(result) << ") ";
-        return {false, ss.str()};
+        return ResponseStatus::ERROR;
     }
-
-    memcpy(addr, result_list->ai_addr, result_list->ai_addrlen);
-    freeaddrinfo(result_list);
-
-    return {true, ""};
+    return ResponseStatus::VALUE;
 }
 
-// Sends a string of bytes to the given destination address.
-// Returns the number of sent bytes and, if -1, the error message.
-std::pair<int, std::string> SendTo(const int sockfd,
-                                   sockaddr_storage& dest_addr,
-                                   const std::vector<unsigned char>& message)
+// Tello doesn't answer "rc", so nothing must wait for it.
+bool IsAnswered(const std::string_view command)
 {
-    const socklen_t addr_len{sizeof(dest_addr)};
-    int result = sendto(sockfd, message.data(), message.size(), 0,
-                        reinterpret_cast<sockaddr*>(&dest_addr), addr_len);
-
-    if (result == -1)
-    {
-        std::stringstream ss;
-        ss << "sendto: " << errno;
-        ss << " (" << strerror(errno) << ")";
-        return {-1, ss.str()};
-    }
-
-    return {result, ""};
+    return command.substr(0, command.find(' ')) != "rc";
 }
 
-// Receives a text response from the given destination address.
-// Returns the number of received bytes and, if -1, the error message.
-std::pair<int, std::string> ReceiveFrom(const int sockfd,
-                                        sockaddr_storage& addr,
-                                        std::vector<unsigned char>& buffer,
-                                        const int buffer_size = 1024,
-                                        const int flags = MSG_DONTWAIT)
+// Messages of several Tellos can be told apart by their address.
+std::string GetLoggerName(const std::string& server_ip,
+                          const std::string& server_command_port)
 {
-    socklen_t addr_len{sizeof(addr)};
-    buffer.resize(buffer_size, '\0');
-    // MSG_DONTWAIT -> Non-blocking
-    // recvfrom is storing (re-populating) the sender address in addr.
-    int result = recvfrom(sockfd, buffer.data(), buffer_size, flags,
-                          reinterpret_cast<sockaddr*>(&addr), &addr_len);
-    if (result == -1)
+    if (server_ip == TELLO_SERVER_IP &&
+        server_command_port == TELLO_SERVER_COMMAND_PORT)
     {
-        std::stringstream ss;
-        ss << "recvfrom: " << errno;
-        ss << " (" << strerror(errno) << ")";
-        return {-1, ss.str()};
+        return "ctello";
     }
-
-    return {result, ""};
+    return "ctello " + server_ip + ":" + server_command_port;
 }
 }  // namespace
 
 namespace ctello
 {
-Tello::Tello()
+Tello::Tello(const std::string& server_ip,
+             const std::string& server_command_port,
+             const int local_server_state_port)
+    : m_server_ip{server_ip},
+      m_server_command_port{server_command_port},
+      m_local_server_state_port{local_server_state_port},
+      m_stats{std::make_unique<StatsCollector>(DEFAULT_COMMAND_TIMEOUT)},
+      m_logger{internal::CreateLogger(
+          GetLoggerName(server_ip, server_command_port))}
 {
     m_command_sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     m_state_sockfd = socket(AF_INET, SOCK_DGRAM, 0);
-    spdlog::set_pattern(LOG_PATTERN);
-    auto log_level = ::GetLogLevelFromEnv("SPDLOG_LEVEL");
-    spdlog::set_level(log_level);
+
+    // Both sockets are watched by the same epoll instance, so callers can
+    // sleep until anything arrives from Tello (see GetPollFd()).
+    m_epoll_fd = epoll_create1(0);
+    for (const int sockfd : {m_command_sockfd, m_state_sockfd})
+    {
+        const auto result = internal::AddToEpoll(m_epoll_fd, sockfd);
+        if (!result.first)
+        {
+            CTELLO_LOGGER_ERROR(m_logger, result.second);
+        }
+    }
 }
 
 Tello::~Tello()
 {
+    StopCommandDispatcher();
+    StopStateReceiver();
+    close(m_epoll_fd);
     close(m_command_sockfd);
     close(m_state_sockfd);
 }
@@ -179,33 +136,35 @@ bool Tello::Bind(const int local_client_command_port)
 {
     // UDP Client to send commands and receive responses
     auto result =
-        ::BindSocketToPort(m_command_sockfd, local_client_command_port);
+        internal::BindSocketToPort(m_command_sockfd, local_client_command_port);
     if (!result.first)
     {
-        spdlog::error(result.second);
+        CTELLO_LOGGER_ERROR(m_logger, result.second);
         return false;
     }
     m_local_client_command_port = local_client_command_port;
-    result = ::FindSocketAddr(TELLO_SERVER_IP, TELLO_SERVER_COMMAND_PORT,
+    result = internal::FindSocketAddr(m_server_ip.c_str(),
+                              m_server_command_port.c_str(),
                               &m_tello_server_command_addr);
     if (!result.first)
     {
-        spdlog::error(result.second);
+        CTELLO_LOGGER_ERROR(m_logger, result.second);
         return false;
     }
 
     // Local UDP Server to listen for the Tello Status
-    result = ::BindSocketToPort(m_state_sockfd, LOCAL_SERVER_STATE_PORT);
+    result = internal::BindSocketToPort(m_state_sockfd,
+                                        m_local_server_state_port);
     if (!result.first)
     {
-        spdlog::error(result.second);
+        CTELLO_LOGGER_ERROR(m_logger, result.second);
         return false;
     }
 
     // Finding Tello
-    spdlog::info("Finding Tello ...");
+    CTELLO_LOGGER_INFO(m_logger, "Finding Tello ...");
     FindTello();
-    spdlog::info("Entered SDK mode");
+    CTELLO_LOGGER_INFO(m_logger, "Entered SDK mode");
 
     ShowTelloInfo();
 
@@ -217,90 +176,703 @@ void Tello::FindTello()
     do
     {
         SendCommand("command");
-        sleep(1);
-    } while (!(ReceiveResponse()));
+    } while (!(WaitForResponse(FIND_TELLO_TIMEOUT)));
 }
 
 void Tello::ShowTelloInfo()
 {
+    // Datagrams may get lost, so don't wait forever.
     std::optional<std::string> response;
 
     SendCommand("sn?");
-    while (!(response = ReceiveResponse()))
-        ;
-    spdlog::info("Serial Number: {0}", *response);
+    response = WaitForResponse(QUERY_TIMEOUT);
+    CTELLO_LOGGER_INFO(m_logger, "Serial Number: {0}", response.value_or("?"));
 
     SendCommand("sdk?");
-    while (!(response = ReceiveResponse()))
-        ;
-    spdlog::info("Tello SDK:     {0}", *response);
+    response = WaitForResponse(QUERY_TIMEOUT);
+    CTELLO_LOGGER_INFO(m_logger, "Tello SDK:     {0}", response.value_or("?"));
 
     SendCommand("wifi?");
-    while (!(response = ReceiveResponse()))
-        ;
-    spdlog::info("Wi-Fi Signal:  {0}", *response);
+    response = WaitForResponse(QUERY_TIMEOUT);
+    CTELLO_LOGGER_INFO(m_logger, "Wi-Fi Signal:  {0}", response.value_or("?"));
 
     SendCommand("battery?");
-    while (!(response = ReceiveResponse()))
-        ;
-    spdlog::info("Battery:       {0}", *response);
+    response = WaitForResponse(QUERY_TIMEOUT);
+    CTELLO_LOGGER_INFO(m_logger, "Battery:       {0}", response.value_or("?"));
 }
 
-bool Tello::SendCommand(const std::string& command)
+bool Tello::SendCommand(const std::string_view command)
 {
-    const std::vector<unsigned char> message{std::cbegin(command),
-                                             std::cend(command)};
-    const auto result =
-        ::SendTo(m_command_sockfd, m_tello_server_command_addr, message);
+    if (m_replay)
+    {
+        CTELLO_LOGGER_DEBUG(m_logger, "replay >>>> {}", command);
+        if (IsAnswered(command))
+        {
+            m_pending_responses.push_back("ok");
+        }
+        return true;
+    }
+    const auto result = internal::SendTo(
+        m_command_sockfd, m_tello_server_command_addr, command);
     const int bytes{result.first};
     if (bytes == -1)
     {
-        spdlog::error(result.second);
+        CTELLO_LOGGER_ERROR(m_logger, result.second);
         return false;
     }
-    spdlog::debug("127.0.0.1:{} >>>> {} bytes >>>> {}:{}: {}",
-                  m_local_client_command_port, bytes, TELLO_SERVER_IP,
-                  TELLO_SERVER_COMMAND_PORT, command);
+    m_stats->OnCommandSent(command, std::chrono::steady_clock::now());
+    CTELLO_LOGGER_DEBUG(m_logger, "127.0.0.1:{} >>>> {} bytes >>>> {}:{}: {}",
+                        m_local_client_command_port, bytes, m_server_ip,
+                        m_server_command_port, command);
     return true;
 }
 
+bool Tello::SendCommand(const cmd::Text& command)
+{
+    if (!command.IsValid())
+    {
+        CTELLO_LOGGER_ERROR(m_logger, "Out of range: {}", command.View());
+        return false;
+    }
+    return SendCommand(command.View());
+}
+
 std::optional<std::string> Tello::ReceiveResponse()
 {
-    const int size{32};
-    std::vector<unsigned char> buffer(size, '\0');
-    const auto result = ::ReceiveFrom(
-        m_command_sockfd, m_tello_server_command_addr, buffer, size);
+    // Short responses fit in the string itself, so they aren't allocated.
+    const auto response =
+        ReceiveResponse(m_response_buffer.data(), m_response_buffer.size());
+    if (!response)
+    {
+        return {};
+    }
+    return std::string{*response};
+}
+
+std::optional<std::string_view> Tello::ReceiveResponse(char* const buffer,
+                                                       const std::size_t size)
+{
+    if (!m_pending_responses.empty())
+    {
+        const std::string& pending{m_pending_responses.front()};
+        const std::size_t length{std::min(pending.size(), size)};
+        std::copy_n(pending.data(), length, buffer);
+        m_pending_responses.pop_front();
+        return std::string_view{buffer, length};
+    }
+    if (m_replay)
+    {
+        return {};
+    }
+    return ReadResponse(buffer, size);
+}
+
+std::optional<std::string> Tello::GetState()
+{
+    if (m_state_receiver_running)
+    {
+        return {};
+    }
+    if (m_replay)
+    {
+        TelloState state;
+        if (m_replay->Next(state))
+        {
+            return FormatState(state);
+        }
+        return {};
+    }
+    if (const auto state = ReadState())
+    {
+        return std::string{*state};
+    }
+    return {};
+}
+
+bool Tello::GetState(TelloState& state)
+{
+    if (m_state_receiver_running)
+    {
+        // Only report states we haven't returned yet.
+        TelloState latest;
+        uint64_t version{m_latest_state.Load(latest)};
+        if (version == m_last_state_version)
+        {
+            return false;
+        }
+        // The poll fd stops being readable until the next state. States
+        // stored before clearing it are loaded again, and later ones signal
+        // it again.
+        internal::ClearSignal(m_state_event_fd);
+        version = m_latest_state.Load(latest);
+        m_last_state_version = version;
+        state = latest;
+        return true;
+    }
+    if (m_replay)
+    {
+        return m_replay->Next(state);
+    }
+    const auto text = ReadState();
+    if (!text)
+    {
+        return false;
+    }
+    if (!ParseState(*text, state))
+    {
+        m_stats->OnMalformedState();
+        CTELLO_LOGGER_WARN(m_logger, "Malformed state: {}", *text);
+        return false;
+    }
+    return true;
+}
+
+std::optional<std::string> Tello::WaitForResponse(
+    const std::chrono::milliseconds timeout)
+{
+    const auto response = WaitForResponse(
+        m_response_buffer.data(), m_response_buffer.size(), timeout);
+    if (!response)
+    {
+        return {};
+    }
+    return std::string{*response};
+}
+
+std::optional<std::string_view> Tello::WaitForResponse(
+    char* const buffer,
+    const std::size_t size,
+    const std::chrono::milliseconds timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true)
+    {
+        if (const auto response = ReceiveResponse(buffer, size))
+        {
+            return response;
+        }
+        const auto time_left = internal::TimeLeft(timeout, deadline);
+        // Replayed commands are answered straight away.
+        if (m_replay)
+        {
+            return {};
+        }
+        // The command might still be answered later, so it doesn't count
+        // as a timeout yet.
+        if (time_left.count() == 0)
+        {
+            return {};
+        }
+        WaitReadable(m_command_sockfd, time_left);
+    }
+}
+
+std::optional<std::string> Tello::WaitForState(
+    const std::chrono::milliseconds timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    if (m_replay)
+    {
+        TelloState state;
+        if (m_replay->WaitForNext(state, timeout))
+        {
+            return FormatState(state);
+        }
+        return {};
+    }
+    while (true)
+    {
+        if (m_state_receiver_running)
+        {
+            return {};
+        }
+        if (auto state = GetState())
+        {
+            return state;
+        }
+        const auto time_left = internal::TimeLeft(timeout, deadline);
+        if (time_left.count() == 0)
+        {
+            return {};
+        }
+        WaitReadable(m_state_sockfd, time_left);
+    }
+}
+
+bool Tello::WaitForState(TelloState& state,
+                         const std::chrono::milliseconds timeout)
+{
+    if (m_replay)
+    {
+        return m_replay->WaitForNext(state, timeout);
+    }
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    bool woken{false};
+    while (true)
+    {
+        if (GetState(state))
+        {
+            return true;
+        }
+        if (woken && m_state_receiver_running)
+        {
+            // The receiver signalled a state which was already taken, so
+            // the signal is stale and would keep waking us up.
+            internal::ClearSignal(m_state_event_fd);
+            if (GetState(state))
+            {
+                return true;
+            }
+        }
+        const auto time_left = internal::TimeLeft(timeout, deadline);
+        if (time_left.count() == 0)
+        {
+            return false;
+        }
+        woken = WaitReadable(m_state_receiver_running ? m_state_event_fd
+                                                      : m_state_sockfd,
+                             time_left);
+    }
+}
+
+int Tello::GetPollFd() const
+{
+    return m_epoll_fd;
+}
+
+bool Tello::WaitReadable(const int fd,
+                         const std::chrono::milliseconds timeout)
+{
+    // Only the awaited fd is watched. Whatever arrives on the other one
+    // stays there, so the poll fd keeps telling callers about it.
+    pollfd fds{fd, POLLIN, 0};
+    const int count = poll(&fds, 1, static_cast<int>(timeout.count()));
+    if (count == -1)
+    {
+        if (errno != EINTR)
+        {
+            CTELLO_LOGGER_ERROR(m_logger, "poll: {} ({})", errno,
+                                strerror(errno));
+        }
+        return false;
+    }
+    return count == 1;
+}
+
+bool Tello::StartStateReceiver(const std::size_t history_capacity)
+{
+    if (m_state_receiver_running)
+    {
+        return true;
+    }
+    if (m_replay)
+    {
+        CTELLO_LOGGER_ERROR(
+            m_logger, "The state receiver isn't available while replaying");
+        return false;
+    }
+    m_state_stop_fd = eventfd(0, EFD_NONBLOCK);
+    m_state_event_fd = eventfd(0, EFD_NONBLOCK);
+    if (m_state_stop_fd == -1 || m_state_event_fd == -1)
+    {
+        CTELLO_LOGGER_ERROR(m_logger, "eventfd: {} ({})", errno,
+                            strerror(errno));
+        close(m_state_stop_fd);
+        close(m_state_event_fd);
+        m_state_stop_fd = m_state_event_fd = -1;
+        return false;
+    }
+    m_state_history = std::make_unique<SpscRing<TelloState>>(history_capacity);
+    // States are timed when they arrive, not when a burst of them is read.
+    const int on{1};
+    setsockopt(m_state_sockfd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+
+    // From now on, waiters are woken up by the receiver instead of the
+    // socket, which only the receiver reads.
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, m_state_sockfd, nullptr);
+    const auto result = internal::AddToEpoll(m_epoll_fd, m_state_event_fd);
+    if (!result.first)
+    {
+        CTELLO_LOGGER_ERROR(m_logger, result.second);
+    }
+    m_state_receiver_running = true;
+    m_state_thread = std::thread{&Tello::ReceiveStates, this};
+    CTELLO_LOGGER_DEBUG(m_logger, "State receiver started");
+    return true;
+}
+
+void Tello::StopStateReceiver()
+{
+    if (!m_state_receiver_running)
+    {
+        return;
+    }
+    internal::Signal(m_state_stop_fd);
+    m_state_thread.join();
+    m_state_receiver_running = false;
+
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, m_state_event_fd, nullptr);
+    const auto result = internal::AddToEpoll(m_epoll_fd, m_state_sockfd);
+    if (!result.first)
+    {
+        CTELLO_LOGGER_ERROR(m_logger, result.second);
+    }
+    close(m_state_stop_fd);
+    close(m_state_event_fd);
+    m_state_stop_fd = m_state_event_fd = -1;
+    CTELLO_LOGGER_DEBUG(m_logger, "State receiver stopped");
+}
+
+uint64_t Tello::GetLatestState(TelloState& state) const
+{
+    return m_latest_state.Load(state);
+}
+
+bool Tello::PopStateHistory(TelloState& state)
+{
+    if (!m_state_history)
+    {
+        return false;
+    }
+    if (m_state_history->Pop(state))
+    {
+        return true;
+    }
+    // The history is empty, so the poll fd stops being readable until the
+    // next state. A state pushed before clearing it is still popped.
+    internal::ClearSignal(m_state_event_fd);
+    return m_state_history->Pop(state);
+}
+
+void Tello::ReceiveStates()
+{
+    std::array<pollfd, 2> fds{{{m_state_sockfd, POLLIN, 0},
+                               {m_state_stop_fd, POLLIN, 0}}};
+    // Bursts of states are drained with few syscalls.
+    DatagramBatch batch{STATE_BATCH_SIZE, MAX_STATE_SIZE};
+    // Fields missing in a state keep their previous value.
+    TelloState state;
+    while (true)
+    {
+        if (poll(fds.data(), fds.size(), -1) == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            CTELLO_LOGGER_ERROR(m_logger, "poll: {} ({})", errno,
+                                strerror(errno));
+            return;
+        }
+        if (fds[1].revents)
+        {
+            return;
+        }
+
+        bool received{false};
+        int count;
+        while ((count = batch.Receive(m_state_sockfd)) > 0)
+        {
+            for (int i = 0; i < count; ++i)
+            {
+                const std::string_view text{batch.Payload(i)};
+                m_stats->OnState(batch.Time(i));
+                if (!ParseState(text, state))
+                {
+                    m_stats->OnMalformedState();
+                    CTELLO_LOGGER_WARN(m_logger, "Malformed state: {}", text);
+                    continue;
+                }
+                m_latest_state.Store(state);
+                if (!m_state_history->Push(state))
+                {
+                    CTELLO_LOGGER_DEBUG(m_logger,
+                                        "State history full, dropping state");
+                }
+                received = true;
+            }
+            if (count < static_cast<int>(batch.Capacity()))
+            {
+                break;
+            }
+        }
+        if (received)
+        {
+            internal::Signal(m_state_event_fd);
+        }
+    }
+}
+
+std::future<Response> Tello::SendCommandAsync(
+    const std::string& command,
+    const std::chrono::milliseconds timeout,
+    const int retries)
+{
+    if (m_replay)
+    {
+        SendCommand(command);
+        Response response{ResponseStatus::OK, {}, 1, {}};
+        if (IsAnswered(command))
+        {
+            response.text = *ReceiveResponse();
+        }
+        std::promise<Response> replayed;
+        replayed.set_value(std::move(response));
+        return replayed.get_future();
+    }
+    if (!m_command_dispatcher_running && !StartCommandDispatcher())
+    {
+        std::promise<Response> failed;
+        failed.set_value({});
+        return failed.get_future();
+    }
+
+    PendingCommand pending{command, timeout, retries, {}};
+    auto future = pending.promise.get_future();
+    {
+        std::lock_guard<std::mutex> lock{m_command_queue_mutex};
+        m_command_queue.push_back(std::move(pending));
+    }
+    internal::Signal(m_command_wakeup_fd);
+    return future;
+}
+
+std::future<Response> Tello::SendCommandAsync(
+    const cmd::Text& command,
+    const std::chrono::milliseconds timeout,
+    const int retries)
+{
+    if (!command.IsValid())
+    {
+        CTELLO_LOGGER_ERROR(m_logger, "Out of range: {}", command.View());
+        std::promise<Response> refused;
+        refused.set_value({ResponseStatus::ERROR, "error", 0, {}});
+        return refused.get_future();
+    }
+    return SendCommandAsync(std::string{command.View()}, timeout, retries);
+}
+
+bool Tello::StartCommandDispatcher()
+{
+    // Several threads may send their first command at the same time.
+    std::lock_guard<std::mutex> lock{m_command_dispatcher_mutex};
+    if (m_command_dispatcher_running)
+    {
+        return true;
+    }
+    if (m_replay)
+    {
+        // Replayed commands are answered straight away.
+        return true;
+    }
+    m_command_wakeup_fd = eventfd(0, EFD_NONBLOCK);
+    if (m_command_wakeup_fd == -1)
+    {
+        CTELLO_LOGGER_ERROR(m_logger, "eventfd: {} ({})", errno,
+                            strerror(errno));
+        return false;
+    }
+    // Responses are only for the dispatcher from now on.
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, m_command_sockfd, nullptr);
+    m_command_dispatcher_running = true;
+    m_command_thread = std::thread{&Tello::DispatchCommands, this};
+    CTELLO_LOGGER_DEBUG(m_logger, "Command dispatcher started");
+    return true;
+}
+
+void Tello::StopCommandDispatcher()
+{
+    std::lock_guard<std::mutex> lock{m_command_dispatcher_mutex};
+    if (!m_command_dispatcher_running)
+    {
+        return;
+    }
+    m_command_dispatcher_running = false;
+    internal::Signal(m_command_wakeup_fd);
+    m_command_thread.join();
+    m_command_queue.clear();
+
+    const auto result = internal::AddToEpoll(m_epoll_fd, m_command_sockfd);
+    if (!result.first)
+    {
+        CTELLO_LOGGER_ERROR(m_logger, result.second);
+    }
+    close(m_command_wakeup_fd);
+    m_command_wakeup_fd = -1;
+    CTELLO_LOGGER_DEBUG(m_logger, "Command dispatcher stopped");
+}
+
+bool Tello::OpenReplay(const std::string& path, const double speed)
+{
+    auto replay = std::make_unique<TelemetryReplay>();
+    if (!replay->Open(path, speed))
+    {
+        return false;
+    }
+    m_replay = std::move(replay);
+    m_pending_responses.clear();
+    return true;
+}
+
+const TelemetryReplay* Tello::GetReplay() const
+{
+    return m_replay.get();
+}
+
+TelloStats Tello::GetStats() const
+{
+    return m_stats->GetStats();
+}
+
+void Tello::SetLogLevel(const LogLevel level)
+{
+    // Same order as spdlog's levels
+    m_logger->set_level(static_cast<spdlog::level::level_enum>(level));
+}
+
+void Tello::DispatchCommands()
+{
+    using std::chrono::steady_clock;
+
+    std::array<pollfd, 2> fds{{{m_command_sockfd, POLLIN, 0},
+                               {m_command_wakeup_fd, POLLIN, 0}}};
+    // Responses never meet the caller's thread, so they have their own buffer.
+    std::array<char, MAX_RESPONSE_SIZE> buffer;
+    std::optional<PendingCommand> current;
+    steady_clock::time_point sent_at;
+    int attempts{0};
+    while (m_command_dispatcher_running)
+    {
+        if (!current)
+        {
+            std::lock_guard<std::mutex> lock{m_command_queue_mutex};
+            if (!m_command_queue.empty())
+            {
+                current = std::move(m_command_queue.front());
+                m_command_queue.pop_front();
+            }
+        }
+        if (current && attempts == 0)
+        {
+            // Whatever arrived meanwhile can't be the answer to this one.
+            while (ReadResponse(buffer.data(), buffer.size()))
+                ;
+            SendCommand(current->command);
+            if (!IsAnswered(current->command))
+            {
+                current->promise.set_value({ResponseStatus::OK, {}, 1, {}});
+                current.reset();
+                continue;
+            }
+            sent_at = steady_clock::now();
+            attempts = 1;
+        }
+
+        const auto time_left =
+            current ? internal::TimeLeft(current->timeout,
+                                         sent_at + current->timeout)
+                    : WAIT_FOREVER;
+        const int ready =
+            poll(fds.data(), fds.size(), static_cast<int>(time_left.count()));
+        if (ready == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            CTELLO_LOGGER_ERROR(m_logger, "poll: {} ({})", errno,
+                                strerror(errno));
+            return;
+        }
+        if (fds[1].revents)
+        {
+            internal::ClearSignal(m_command_wakeup_fd);
+        }
+
+        if (fds[0].revents)
+        {
+            const auto response = ReadResponse(buffer.data(), buffer.size());
+            if (response && current)
+            {
+                Response result;
+                result.status = ::GetResponseStatus(*response);
+                result.text = *response;
+                result.attempts = attempts;
+                result.latency =
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        steady_clock::now() - sent_at);
+                current->promise.set_value(std::move(result));
+                current.reset();
+                attempts = 0;
+            }
+            else if (response)
+            {
+                CTELLO_LOGGER_WARN(m_logger, "Unexpected response: {}",
+                                   *response);
+            }
+        }
+        else if (current &&
+                 steady_clock::now() >= sent_at + current->timeout)
+        {
+            m_stats->OnTimeout();
+            if (attempts <= current->retries)
+            {
+                CTELLO_LOGGER_WARN(m_logger, "Timeout, resending: {}",
+                                   current->command);
+                SendCommand(current->command);
+                sent_at = steady_clock::now();
+                ++attempts;
+            }
+            else
+            {
+                CTELLO_LOGGER_WARN(m_logger, "Timeout: {}", current->command);
+                Response result;
+                result.attempts = attempts;
+                current->promise.set_value(std::move(result));
+                current.reset();
+                attempts = 0;
+            }
+        }
+    }
+}
+
+std::optional<std::string_view> Tello::ReadResponse(char* const buffer,
+                                                    const std::size_t size)
+{
+    // Don't let the sender overwrite the Tello address, the dispatcher
+    // thread may be reading it.
+    sockaddr_storage addr;
+    const auto result =
+        internal::ReceiveFrom(m_command_sockfd, addr, buffer, size);
     const int bytes{result.first};
     if (bytes < 1)
     {
         return {};
     }
-    std::string response{buffer.cbegin(), buffer.cbegin() + bytes};
-    // Some responses contain trailing white spaces.
-    response.erase(response.find_last_not_of(" \n\r\t") + 1);
-    spdlog::debug("127.0.0.1:{} <<<< {} bytes <<<< {}:{}: {}",
-                  m_local_client_command_port, bytes, TELLO_SERVER_IP,
-                  TELLO_SERVER_COMMAND_PORT, response);
+    const std::string_view response{
+        TrimRight({buffer, static_cast<std::size_t>(bytes)})};
+    m_stats->OnResponse(response, std::chrono::steady_clock::now());
+    CTELLO_LOGGER_DEBUG(m_logger, "127.0.0.1:{} <<<< {} bytes <<<< {}:{}: {}",
+                        m_local_client_command_port, bytes, m_server_ip,
+                        m_server_command_port, response);
     return response;
 }
 
-std::optional<std::string> Tello::GetState()
+std::optional<std::string_view> Tello::ReadState()
 {
     sockaddr_storage addr;
-    const int size{1024};
-    std::vector<unsigned char> buffer(size, '\0');
-    const auto result = ::ReceiveFrom(m_state_sockfd, addr, buffer, size);
+    const auto result = internal::ReceiveFrom(
+        m_state_sockfd, addr, m_state_buffer.data(), m_state_buffer.size());
     const int bytes{result.first};
     if (bytes < 1)
     {
         return {};
     }
-    std::string response{std::cbegin(buffer), std::cbegin(buffer) + bytes};
-    // Some responses contain trailing white spaces.
-    response.erase(response.find_last_not_of(" \n\r\t") + 1);
-    spdlog::debug("127.0.0.1:{} <<<< {} bytes <<<< {}:{}: <state>",
-                  m_local_client_command_port, bytes, TELLO_SERVER_IP,
-                  TELLO_SERVER_COMMAND_PORT);
-    return response;
+    m_stats->OnState(std::chrono::steady_clock::now());
+    CTELLO_LOGGER_DEBUG(m_logger,
+                        "127.0.0.1:{} <<<< {} bytes <<<< {}:{}: <state>",
+                        m_local_client_command_port, bytes, m_server_ip,
+                        m_server_command_port);
+    return TrimRight({m_state_buffer.data(), static_cast<std::size_t>(bytes)});
 }
 }  // namespace ctello
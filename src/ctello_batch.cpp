@@ -0,0 +1,200 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#include "ctello_batch.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "ctello_internal.h"
+
+namespace
+{
+// Room for a SCM_TIMESTAMPNS message
+const std::size_t CONTROL_SIZE{CMSG_SPACE(sizeof(timespec))};
+
+// Size of the address of the given family, or 0 if unknown
+socklen_t GetAddressSize(const sa_family_t family)
+{
+    switch (family)
+    {
+    case AF_INET:
+        return sizeof(sockaddr_in);
+    case AF_INET6:
+        return sizeof(sockaddr_in6);
+    default:
+        return 0;
+    }
+}
+
+std::chrono::nanoseconds ToNanoseconds(const timespec& time)
+{
+    return std::chrono::seconds{time.tv_sec} +
+           std::chrono::nanoseconds{time.tv_nsec};
+}
+}  // namespace
+
+namespace ctello
+{
+DatagramBatch::DatagramBatch(const std::size_t capacity,
+                             const std::size_t datagram_size)
+    : m_datagram_size{datagram_size},
+      m_headers(capacity),
+      m_iovecs(capacity),
+      m_addrs(capacity),
+      m_lengths(capacity),
+      m_times(capacity),
+      m_control(capacity * CONTROL_SIZE),
+      m_buffer(capacity * datagram_size)
+{
+    for (std::size_t i = 0; i < capacity; ++i)
+    {
+        msghdr& header{m_headers[i].msg_hdr};
+        header.msg_iov = &m_iovecs[i];
+        header.msg_iovlen = 1;
+        header.msg_name = &m_addrs[i];
+    }
+}
+
+void DatagramBatch::Clear()
+{
+    m_size = 0;
+}
+
+bool DatagramBatch::Add(const sockaddr_storage& dest,
+                        const std::string_view payload)
+{
+    const socklen_t address_size{GetAddressSize(dest.ss_family)};
+    if (m_size == m_headers.size() || address_size == 0)
+    {
+        return false;
+    }
+    m_addrs[m_size] = dest;
+    m_headers[m_size].msg_hdr.msg_namelen = address_size;
+    // sendmmsg doesn't write into the payload.
+    m_iovecs[m_size].iov_base = const_cast<char*>(payload.data());
+    m_iovecs[m_size].iov_len = payload.size();
+    m_lengths[m_size] = payload.size();
+    m_headers[m_size].msg_hdr.msg_control = nullptr;
+    m_headers[m_size].msg_hdr.msg_controllen = 0;
+    ++m_size;
+    return true;
+}
+
+int DatagramBatch::Send(const int sockfd)
+{
+    // sendmmsg may send only some of them.
+    std::size_t sent{0};
+    while (sent < m_size)
+    {
+        const int result =
+            sendmmsg(sockfd, &m_headers[sent], m_size - sent, 0);
+        if (result == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            CTELLO_ERROR("sendmmsg: {} ({})", errno, strerror(errno));
+            return sent > 0 ? sent : -1;
+        }
+        sent += result;
+    }
+    return sent;
+}
+
+int DatagramBatch::Receive(const int sockfd)
+{
+    for (std::size_t i = 0; i < m_headers.size(); ++i)
+    {
+        m_iovecs[i].iov_base = &m_buffer[i * m_datagram_size];
+        m_iovecs[i].iov_len = m_datagram_size;
+        m_headers[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+        m_headers[i].msg_hdr.msg_control = &m_control[i * CONTROL_SIZE];
+        m_headers[i].msg_hdr.msg_controllen = CONTROL_SIZE;
+    }
+    const int result = recvmmsg(sockfd, m_headers.data(), m_headers.size(),
+                                MSG_DONTWAIT, nullptr);
+    if (result == -1)
+    {
+        m_size = 0;
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            CTELLO_ERROR("recvmmsg: {} ({})", errno, strerror(errno));
+            return -1;
+        }
+        return 0;
+    }
+    m_size = result;
+    // Kernel timestamps are in CLOCK_REALTIME, which can jump, so they are
+    // taken as how long ago the datagrams arrived.
+    const auto now = std::chrono::steady_clock::now();
+    timespec realtime{};
+    clock_gettime(CLOCK_REALTIME, &realtime);
+    for (std::size_t i = 0; i < m_size; ++i)
+    {
+        m_lengths[i] = m_headers[i].msg_len;
+        m_times[i] = now;
+        msghdr& header{m_headers[i].msg_hdr};
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&header); cmsg;
+             cmsg = CMSG_NXTHDR(&header, cmsg))
+        {
+            if (cmsg->cmsg_level == SOL_SOCKET &&
+                cmsg->cmsg_type == SCM_TIMESTAMPNS)
+            {
+                timespec stamp;
+                std::memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+                const auto age = ToNanoseconds(realtime) - ToNanoseconds(stamp);
+                m_times[i] = now - std::max(age, std::chrono::nanoseconds{0});
+            }
+        }
+    }
+    return result;
+}
+
+std::size_t DatagramBatch::Size() const
+{
+    return m_size;
+}
+
+std::size_t DatagramBatch::Capacity() const
+{
+    return m_headers.size();
+}
+
+std::string_view DatagramBatch::Payload(const std::size_t index) const
+{
+    return {static_cast<const char*>(m_iovecs[index].iov_base),
+            m_lengths[index]};
+}
+
+const sockaddr_storage& DatagramBatch::Address(const std::size_t index) const
+{
+    return m_addrs[index];
+}
+
+std::chrono::steady_clock::time_point DatagramBatch::Time(
+    const std::size_t index) const
+{
+    return m_times[index];
+}
+}  // namespace ctello
@@ -0,0 +1,682 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "ctello.h"
+#include "ctello_batch.h"
+#include "ctello_detector.h"
+#include "ctello_simulator.h"
+
+using ctello::Blob;
+using ctello::BlobDetector;
+using ctello::BrightTargetDetector;
+using ctello::DatagramBatch;
+using ctello::ImageView;
+using ctello::SimdKernel;
+using ctello::Simulator;
+using ctello::SimulatorOptions;
+using ctello::Target;
+using ctello::TargetTracker;
+using ctello::Tello;
+using ctello::TelloState;
+using Clock = std::chrono::steady_clock;
+
+// Ports of the stand-in Tello, away from the real ones so the benchmark can
+// run next to other tools.
+const int BENCH_COMMAND_PORT{28889};
+const int BENCH_STATE_PORT{28890};
+const int BENCH_CLIENT_PORT{29000};
+
+// Commands sent before reading their responses, small enough for all the
+// responses to fit in the socket buffer.
+const int COMMAND_BATCH_SIZE{64};
+
+// Datagrams per sendmmsg/recvmmsg when comparing them with sendto/recvfrom
+const int DATAGRAM_BATCH_SIZE{32};
+
+// Size of a Tello frame, and of the light placed in it
+const int FRAME_ROWS{720};
+const int FRAME_COLS{960};
+const int LIGHT_ROW{240};
+const int LIGHT_COL{600};
+const int LIGHT_SIZE{60};
+
+// Frames scanned by every target detector
+const int DETECTION_FRAMES{200};
+
+const char* const BENCH_STATE{
+    "mid:-1;x:0;y:0;z:0;mpry:0,0,0;pitch:1;roll:-2;yaw:35;vgx:0;vgy:0;vgz:0;"
+    "templ:62;temph:65;tof:95;h:80;bat:87;baro:162.43;time:17;agx:-5.00;"
+    "agy:1.00;agz:-1001.00;\r\n"};
+
+// clang-format off
+const char* const USAGE =
+"Usage: ctello-bench [OPTIONS]\n"
+"\n"
+"Benchmarks ctello::Tello against an in-process simulator.\n"
+"\n"
+"  -n, --iterations N   Command round trips to measure       [10000]\n"
+"  -d, --duration S     Seconds to flood states for          [2]\n"
+"  -j, --json           Print the results as JSON\n"
+"  -h, --help           Show this help\n";
+// clang-format on
+
+// Allocations made by the current thread, counted by operator new below.
+thread_local uint64_t t_allocations{0};
+
+void* operator new(const std::size_t size)
+{
+    ++t_allocations;
+    if (void* const ptr = std::malloc(size))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* const ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* const ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+namespace
+{
+// Results in the order they were added, grouped in sections.
+class Report
+{
+public:
+    void Add(const std::string& section,
+             const std::string& name,
+             const double value)
+    {
+        if (m_sections.empty() || m_sections.back().first != section)
+        {
+            m_sections.push_back({section, {}});
+        }
+        m_sections.back().second.push_back({name, value});
+    }
+
+    void PrintText(std::ostream& os) const
+    {
+        for (const auto& section : m_sections)
+        {
+            os << section.first << std::endl;
+            for (const auto& entry : section.second)
+            {
+                os << "  " << std::left << std::setw(24) << entry.first
+                   << std::right << std::setw(16) << std::fixed
+                   << std::setprecision(2) << entry.second << std::endl;
+            }
+        }
+    }
+
+    void PrintJson(std::ostream& os) const
+    {
+        os << "{" << std::endl;
+        for (std::size_t i = 0; i < m_sections.size(); ++i)
+        {
+            const auto& section = m_sections[i];
+            os << "  \"" << section.first << "\": {" << std::endl;
+            for (std::size_t j = 0; j < section.second.size(); ++j)
+            {
+                const auto& entry = section.second[j];
+                os << "    \"" << entry.first << "\": " << std::fixed
+                   << std::setprecision(3) << entry.second
+                   << (j + 1 < section.second.size() ? "," : "")
+                   << std::endl;
+            }
+            os << "  }" << (i + 1 < m_sections.size() ? "," : "")
+               << std::endl;
+        }
+        os << "}" << std::endl;
+    }
+
+private:
+    using Entries = std::vector<std::pair<std::string, double>>;
+    std::vector<std::pair<std::string, Entries>> m_sections;
+};
+
+// CPU time (user + system) consumed by the current thread.
+std::chrono::nanoseconds ThreadCpuTime()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds{ts.tv_sec} +
+           std::chrono::nanoseconds{ts.tv_nsec};
+}
+
+void AddPerMessage(Report& report,
+                   const std::string& section,
+                   const int messages,
+                   const std::chrono::nanoseconds cpu,
+                   const uint64_t allocations)
+{
+    const double count = std::max(messages, 1);
+    report.Add(section, "messages", messages);
+    report.Add(section, "cpu_ns_per_message", cpu.count() / count);
+    report.Add(section, "allocations_per_message", allocations / count);
+}
+
+// CPU time and allocations of the current thread between construction and
+// Stop(), divided by the number of messages.
+class Meter
+{
+public:
+    Meter() : m_cpu{ThreadCpuTime()}, m_allocations{t_allocations} {}
+
+    void Stop(Report& report, const std::string& section, const int messages)
+    {
+        AddPerMessage(report, section, messages, ThreadCpuTime() - m_cpu,
+                      t_allocations - m_allocations);
+    }
+
+private:
+    std::chrono::nanoseconds m_cpu;
+    uint64_t m_allocations;
+};
+
+// Nearest-rank percentile of sorted samples.
+double Percentile(const std::vector<double>& sorted, const double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    const auto rank = static_cast<std::size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+void BenchCommandRoundTrip(Tello& tello, const int iterations, Report& report)
+{
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    int timeouts{0};
+    for (int i = 0; i < iterations; ++i)
+    {
+        const auto start = Clock::now();
+        tello.SendCommand("battery?");
+        if (!tello.WaitForResponse(std::chrono::milliseconds{1000}))
+        {
+            ++timeouts;
+            continue;
+        }
+        const std::chrono::duration<double, std::micro> rtt{Clock::now() -
+                                                            start};
+        samples.push_back(rtt.count());
+    }
+    std::sort(samples.begin(), samples.end());
+
+    const std::string section{"command_rtt_us"};
+    report.Add(section, "samples", samples.size());
+    report.Add(section, "timeouts", timeouts);
+    report.Add(section, "p50", Percentile(samples, 0.5));
+    report.Add(section, "p99", Percentile(samples, 0.99));
+    report.Add(section, "p999", Percentile(samples, 0.999));
+    report.Add(section, "max", samples.empty() ? 0 : samples.back());
+}
+
+void BenchCommandCalls(Tello& tello, const int iterations, Report& report)
+{
+    std::chrono::nanoseconds send_cpu{0};
+    std::chrono::nanoseconds receive_cpu{0};
+    uint64_t send_allocations{0};
+    uint64_t receive_allocations{0};
+    int sent{0};
+    int received{0};
+    while (sent < iterations)
+    {
+        auto cpu = ThreadCpuTime();
+        auto allocations = t_allocations;
+        for (int i = 0; i < COMMAND_BATCH_SIZE; ++i)
+        {
+            sent += tello.SendCommand("battery?");
+        }
+        send_cpu += ThreadCpuTime() - cpu;
+        send_allocations += t_allocations - allocations;
+
+        // Let the simulator answer all of them.
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+
+        cpu = ThreadCpuTime();
+        allocations = t_allocations;
+        while (tello.ReceiveResponse())
+        {
+            ++received;
+        }
+        receive_cpu += ThreadCpuTime() - cpu;
+        receive_allocations += t_allocations - allocations;
+    }
+
+    AddPerMessage(report, "SendCommand", sent, send_cpu, send_allocations);
+    AddPerMessage(report, "ReceiveResponse", received, receive_cpu,
+                  receive_allocations);
+}
+
+// Floods the state port of the client with states until stopped.
+void FloodStates(const std::atomic<bool>& running, uint64_t& sent)
+{
+    const int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in dest{};
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(BENCH_STATE_PORT);
+    dest.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    const std::size_t size{std::char_traits<char>::length(BENCH_STATE)};
+    while (running)
+    {
+        if (sendto(sockfd, BENCH_STATE, size, 0,
+                   reinterpret_cast<sockaddr*>(&dest), sizeof(dest)) > 0)
+        {
+            ++sent;
+        }
+    }
+    close(sockfd);
+}
+
+// Receives states as fast as possible for the given time, while another
+// thread floods the state port. Returns how many were received.
+template <typename Receive>
+int ReceiveStates(const std::chrono::duration<double> duration,
+                  Receive receive,
+                  uint64_t& sent)
+{
+    std::atomic<bool> running{true};
+    std::thread flooder{FloodStates, std::cref(running), std::ref(sent)};
+    const auto end = Clock::now() + duration;
+    int received{0};
+    while (Clock::now() < end)
+    {
+        received += receive();
+    }
+    running = false;
+    flooder.join();
+    return received;
+}
+
+void BenchStates(Tello& tello, const double duration, Report& report)
+{
+    const std::chrono::duration<double> seconds{duration};
+
+    // Waiting instead of polling, so only the cost of actually receiving
+    // and parsing is measured.
+    const std::chrono::milliseconds timeout{100};
+
+    // Throughput of the typed, allocation-free path.
+    uint64_t sent{0};
+    TelloState state;
+    Meter meter;
+    const auto start = Clock::now();
+    const int parsed = ReceiveStates(
+        seconds, [&]() { return tello.WaitForState(state, timeout); }, sent);
+    const std::chrono::duration<double> elapsed{Clock::now() - start};
+    meter.Stop(report, "GetState(TelloState&)", parsed);
+    report.Add("state_throughput", "sent", sent);
+    report.Add("state_throughput", "parsed", parsed);
+    report.Add("state_throughput", "packets_per_sec",
+               parsed / elapsed.count());
+
+    // Drain leftovers before measuring the string version.
+    while (tello.GetState(state))
+        ;
+    sent = 0;
+    Meter string_meter;
+    const int received = ReceiveStates(
+        seconds, [&]() { return tello.WaitForState(timeout).has_value(); },
+        sent);
+    string_meter.Stop(report, "GetState()", received);
+}
+
+// Compares one syscall per datagram with batches of DATAGRAM_BATCH_SIZE,
+// sending states over loopback and draining them right after.
+void BenchDatagramBatch(const int iterations, Report& report)
+{
+    const int receiver = socket(AF_INET, SOCK_DGRAM, 0);
+    const int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_storage dest{};
+    sockaddr_in& dest_in{reinterpret_cast<sockaddr_in&>(dest)};
+    dest_in.sin_family = AF_INET;
+    dest_in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t dest_len{sizeof(dest_in)};
+    // Any free port will do.
+    if (bind(receiver, reinterpret_cast<sockaddr*>(&dest_in),
+             sizeof(dest_in)) == -1 ||
+        getsockname(receiver, reinterpret_cast<sockaddr*>(&dest_in),
+                    &dest_len) == -1)
+    {
+        std::cerr << "Couldn't bind the batch receiver" << std::endl;
+        close(sender);
+        close(receiver);
+        return;
+    }
+
+    const std::string_view payload{BENCH_STATE};
+    const int rounds{std::max(iterations / DATAGRAM_BATCH_SIZE, 1)};
+    std::array<char, 1024> buffer;
+    DatagramBatch send_batch{DATAGRAM_BATCH_SIZE, 0};
+    DatagramBatch receive_batch{DATAGRAM_BATCH_SIZE, buffer.size()};
+    for (int i = 0; i < DATAGRAM_BATCH_SIZE; ++i)
+    {
+        send_batch.Add(dest, payload);
+    }
+
+    std::chrono::nanoseconds cpu[4]{};
+    uint64_t allocations[4]{};
+    int messages[4]{};
+    const auto measure = [&](const int index, auto&& io)
+    {
+        const auto start_cpu = ThreadCpuTime();
+        const auto start_allocations = t_allocations;
+        messages[index] += io();
+        cpu[index] += ThreadCpuTime() - start_cpu;
+        allocations[index] += t_allocations - start_allocations;
+    };
+
+    const auto send_each = [&]()
+    {
+        int sent{0};
+        for (int i = 0; i < DATAGRAM_BATCH_SIZE; ++i)
+        {
+            sent += sendto(sender, payload.data(), payload.size(), 0,
+                           reinterpret_cast<sockaddr*>(&dest),
+                           sizeof(dest_in)) > 0;
+        }
+        return sent;
+    };
+    const auto receive_each = [&]()
+    {
+        int received{0};
+        while (recvfrom(receiver, buffer.data(), buffer.size(), MSG_DONTWAIT,
+                        nullptr, nullptr) > 0)
+        {
+            ++received;
+        }
+        return received;
+    };
+    const auto send_batched = [&]() { return send_batch.Send(sender); };
+    const auto receive_batched = [&]()
+    { return receive_batch.Receive(receiver); };
+
+    for (int round = 0; round < rounds; ++round)
+    {
+        measure(0, send_each);
+        measure(1, receive_each);
+        measure(2, send_batched);
+        measure(3, receive_batched);
+    }
+
+    const char* const sections[4]{"sendto", "recvfrom", "sendmmsg",
+                                  "recvmmsg"};
+    for (int i = 0; i < 4; ++i)
+    {
+        AddPerMessage(report, sections[i], messages[i], cpu[i],
+                      allocations[i]);
+    }
+    close(sender);
+    close(receiver);
+}
+
+// The pixel by pixel loop the follow example used before
+// BrightTargetDetector, as the reference to compare with.
+std::optional<Target> FindTargetReference(const ImageView& image)
+{
+    int max_row_count{0};
+    int max_row_index{0};
+    std::vector<int> cols_count(image.cols, 0);
+    for (int i = 0; i < image.rows; ++i)
+    {
+        int row_count{0};
+        for (int j = 0; j < image.cols; ++j)
+        {
+            const uint8_t* const pixel{image.data + i * image.step + 3 * j};
+            const bool is_target =
+                pixel[0] > 250 && pixel[1] > 250 && pixel[2] > 250;
+            row_count += is_target;
+            cols_count[j] += is_target;
+        }
+        if (row_count > max_row_count)
+        {
+            max_row_count = row_count;
+            max_row_index = i;
+        }
+    }
+    const auto max_col_iter =
+        std::max_element(std::cbegin(cols_count), std::cend(cols_count));
+    Target target;
+    target.row = max_row_index;
+    target.col = std::distance(std::cbegin(cols_count), max_col_iter);
+    if (target.row == 0 && target.col == 0)
+    {
+        return {};
+    }
+    return target;
+}
+
+// Compares the frames per second of the target detectors on a noisy frame
+// with a light in it.
+void BenchTargetDetector(Report& report)
+{
+    std::vector<uint8_t> pixels(FRAME_ROWS * FRAME_COLS * 3);
+    std::mt19937 generator{42};
+    std::uniform_int_distribution<int> noise{0, 255};
+    for (uint8_t& byte : pixels)
+    {
+        byte = noise(generator);
+    }
+    for (int i = 0; i < LIGHT_SIZE; ++i)
+    {
+        const int row{LIGHT_ROW + i};
+        const auto first = pixels.begin() + (row * FRAME_COLS + LIGHT_COL) * 3;
+        std::fill(first, first + LIGHT_SIZE * 3, 255);
+    }
+    const ImageView image{pixels.data(), FRAME_ROWS, FRAME_COLS,
+                          FRAME_COLS * 3, 3};
+
+    const std::string section{"target_detection_fps"};
+    // The noise may add a few target pixels anywhere, but the row and the
+    // column with most of them must be the light's.
+    const auto in_light = [](const std::optional<Target>& target)
+    {
+        return target && target->row >= LIGHT_ROW &&
+               target->row < LIGHT_ROW + LIGHT_SIZE &&
+               target->col >= LIGHT_COL && target->col < LIGHT_COL + LIGHT_SIZE;
+    };
+    const auto measure = [&](const std::string& name, auto&& find)
+    {
+        const auto start = Clock::now();
+        for (int i = 0; i < DETECTION_FRAMES; ++i)
+        {
+            if (!in_light(find()))
+            {
+                std::cerr << name << " missed the target" << std::endl;
+                return;
+            }
+        }
+        const std::chrono::duration<double> elapsed{Clock::now() - start};
+        report.Add(section, name, DETECTION_FRAMES / elapsed.count());
+    };
+
+    measure("reference", [&]() { return FindTargetReference(image); });
+    for (const SimdKernel kernel :
+         {SimdKernel::SCALAR, SimdKernel::SSSE3, SimdKernel::AVX2})
+    {
+        BrightTargetDetector detector{250, 1, kernel};
+        if (detector.GetKernel() == kernel)
+        {
+            measure(ToString(kernel), [&]() { return detector.Find(image); });
+        }
+    }
+    // Just the luma, as it comes out of the decoder
+    std::vector<uint8_t> luma(FRAME_ROWS * FRAME_COLS);
+    for (std::size_t i = 0; i < luma.size(); ++i)
+    {
+        luma[i] = (pixels[3 * i] + pixels[3 * i + 1] + pixels[3 * i + 2]) / 3;
+    }
+    const ImageView luma_image{luma.data(), FRAME_ROWS, FRAME_COLS,
+                               FRAME_COLS, 1};
+    for (const SimdKernel kernel :
+         {SimdKernel::SCALAR, SimdKernel::SSSE3, SimdKernel::AVX2})
+    {
+        BrightTargetDetector detector{250, 1, kernel};
+        if (detector.GetKernel() == kernel)
+        {
+            measure(std::string{ToString(kernel)} + "_luma",
+                    [&]() { return detector.Find(luma_image); });
+        }
+    }
+
+    BrightTargetDetector parallel_detector{250, 0};
+    measure(std::string{ToString(parallel_detector.GetKernel())} +
+                "_all_cores",
+            [&]() { return parallel_detector.Find(image); });
+
+    // Labelling every blob, the biggest must be the light.
+    const auto biggest_blob = [](const std::vector<Blob>& blobs)
+    {
+        std::optional<Target> target;
+        if (!blobs.empty())
+        {
+            target = Target{static_cast<int>(blobs[0].row),
+                            static_cast<int>(blobs[0].col), blobs[0].area};
+        }
+        return target;
+    };
+    BlobDetector blob_detector;
+    measure("blobs",
+            [&]() { return biggest_blob(blob_detector.Find(image)); });
+    BlobDetector parallel_blob_detector{250, 0};
+    measure("blobs_all_cores", [&]()
+            { return biggest_blob(parallel_blob_detector.Find(image)); });
+
+    // Following the light from frame to frame, and finding it again every
+    // frame as if it had been lost.
+    BrightTargetDetector detector;
+    TargetTracker tracker{detector};
+    measure("tracked", [&]() { return tracker.Track(image); });
+    measure("coarse_scan",
+            [&]()
+            {
+                tracker.Reset();
+                return tracker.Track(image);
+            });
+}
+}  // namespace
+
+int main(const int argc, char* const args[])
+{
+    // clang-format off
+    const option long_options[] = {
+        {"iterations", required_argument, nullptr, 'n'},
+        {"duration",   required_argument, nullptr, 'd'},
+        {"json",       no_argument,       nullptr, 'j'},
+        {"help",       no_argument,       nullptr, 'h'},
+        {nullptr,      0,                 nullptr, 0}
+    };
+    // clang-format on
+
+    int iterations{10000};
+    double duration{2};
+    bool json{false};
+    int opt;
+    while ((opt = getopt_long(argc, args, "n:d:jh", long_options, nullptr)) !=
+           -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            iterations = std::atoi(optarg);
+            break;
+        case 'd':
+            duration = std::atof(optarg);
+            break;
+        case 'j':
+            json = true;
+            break;
+        case 'h':
+            std::cout << USAGE;
+            return 0;
+        default:
+            std::cerr << USAGE;
+            return 1;
+        }
+    }
+
+    // Keep the output clean, unless asked otherwise.
+    setenv("SPDLOG_LEVEL", "warn", 0);
+
+    SimulatorOptions options;
+    options.command_port = BENCH_COMMAND_PORT;
+    options.state_port = BENCH_STATE_PORT;
+    // States are flooded by the benchmark itself.
+    options.state_rate = 0;
+    Simulator simulator{options};
+    if (!simulator.Bind())
+    {
+        return 1;
+    }
+    std::thread simulator_thread{&Simulator::Run, &simulator};
+
+    Report report;
+    {
+        Tello tello{options.ip, std::to_string(BENCH_COMMAND_PORT),
+                    BENCH_STATE_PORT};
+        if (tello.Bind(BENCH_CLIENT_PORT))
+        {
+            BenchCommandRoundTrip(tello, iterations, report);
+            BenchCommandCalls(tello, iterations, report);
+            BenchStates(tello, duration, report);
+        }
+    }
+    BenchDatagramBatch(iterations, report);
+
+    simulator.Stop();
+    simulator_thread.join();
+    BenchTargetDetector(report);
+
+    if (json)
+    {
+        report.PrintJson(std::cout);
+    }
+    else
+    {
+        report.PrintText(std::cout);
+    }
+    return 0;
+}
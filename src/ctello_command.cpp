@@ -74,12 +74,19 @@ const char* const HELP =
 "  wifi?         Obtain Wi-Fi SNR                                 snr       \n"
 "  sdk?          Obtain the Tello SDK version                     version   \n"
 "  sn?           Obtain the Tello serial number                   serial    \n"
+"\n"
+"CTELLO COMMANDS\n"
+"  stats         Latency and errors per command, and state arrivals\n"
+"  help          Show this help\n"
+"  exit          Quit\n"
 "\n";
 // clang-format on
 
 int main(const int argc, const char* const args[])
 {
-    Tello tello{};
+    // Usage: ctello-command [local_port [tello_ip [tello_port]]]
+    Tello tello{argc > 2 ? args[2] : TELLO_SERVER_IP,
+                argc > 3 ? args[3] : TELLO_SERVER_COMMAND_PORT};
     bool bound{false};
     if (argc > 1)
     {
@@ -106,16 +113,27 @@ int main(const int argc, const char* const args[])
         {
             std::cout << HELP << std::endl;
         }
+        else if (command == "stats")
+        {
+            ctello::PrintStats(std::cout, tello.GetStats());
+        }
+        else if (command.rfind("rc ", 0) == 0)
+        {
+            // Tello doesn't answer "rc".
+            tello.SendCommandAsync(command);
+        }
         else if (command.size() > 0)
         {
-            tello.SendCommand(command);
             // Wait for response
-            std::optional<std::string> response;
-            do
+            const auto response = tello.SendCommandAsync(command).get();
+            if (response.status == ctello::Response::Status::TIMEOUT)
+            {
+                std::cout << "timeout" << std::endl;
+            }
+            else
             {
-                response = tello.ReceiveResponse();
-            } while (!response);
-            std::cout << *response << std::endl;
+                std::cout << response.text << std::endl;
+            }
         }
         std::cout << PROMPT << std::flush;
     }
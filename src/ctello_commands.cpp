@@ -0,0 +1,88 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#include "ctello_commands.h"
+
+#include <algorithm>
+#include <charconv>
+
+namespace ctello::cmd
+{
+Text::Text(const std::string_view verb, const bool valid) : m_valid{valid}
+{
+    m_size = std::min(verb.size(), m_buffer.size());
+    std::copy_n(verb.data(), m_size, m_buffer.data());
+}
+
+Text& Text::Append(const int value)
+{
+    // A space and any int always fit, as commands have few values.
+    m_buffer[m_size++] = ' ';
+    const auto result = std::to_chars(m_buffer.data() + m_size,
+                                      m_buffer.data() + m_buffer.size(), value);
+    m_size = result.ptr - m_buffer.data();
+    return *this;
+}
+
+Text& Text::Append(const char value)
+{
+    m_buffer[m_size++] = ' ';
+    m_buffer[m_size++] = value;
+    return *this;
+}
+
+std::string_view Text::View() const
+{
+    return {m_buffer.data(), m_size};
+}
+
+bool Text::IsValid() const
+{
+    return m_valid;
+}
+
+Flip::operator Text() const
+{
+    return Text{"flip"}.Append(static_cast<char>(m_direction));
+}
+
+Go::operator Text() const
+{
+    return Text{"go", m_valid}.Append(m_x).Append(m_y).Append(m_z).Append(
+        m_speed);
+}
+
+Curve::operator Text() const
+{
+    Text text{"curve", m_valid};
+    for (const int coordinate : m_points)
+    {
+        text.Append(coordinate);
+    }
+    return text.Append(m_speed);
+}
+
+Rc::operator Text() const
+{
+    return Text{"rc", m_valid}
+        .Append(m_left_right)
+        .Append(m_forward_backward)
+        .Append(m_up_down)
+        .Append(m_yaw);
+}
+}  // namespace ctello::cmd
@@ -0,0 +1,156 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#include "ctello_controller.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+#include "ctello_internal.h"
+#include "spdlog/spdlog.h"
+
+namespace ctello
+{
+PidController::PidController(const PidGains& gains, const double limit)
+    : m_gains{gains}, m_limit{limit}
+{
+}
+
+double PidController::Update(const double error, const double seconds)
+{
+    m_terms.p = m_gains.kp * error;
+    m_terms.i = 0;
+    m_terms.d = 0;
+    if (m_has_previous && seconds > 0)
+    {
+        m_integral += error * seconds;
+        if (m_gains.ki != 0)
+        {
+            const double max_integral{m_limit / std::abs(m_gains.ki)};
+            m_integral = std::clamp(m_integral, -max_integral, max_integral);
+        }
+        m_terms.i = m_gains.ki * m_integral;
+        m_terms.d = m_gains.kd * (error - m_previous_error) / seconds;
+    }
+    m_previous_error = error;
+    m_has_previous = true;
+    return std::clamp(m_terms.p + m_terms.i + m_terms.d, -m_limit, m_limit);
+}
+
+void PidController::Reset()
+{
+    m_terms = {};
+    m_integral = 0;
+    m_previous_error = 0;
+    m_has_previous = false;
+}
+
+void PidController::SetGains(const PidGains& gains)
+{
+    m_gains = gains;
+}
+
+const PidGains& PidController::GetGains() const
+{
+    return m_gains;
+}
+
+const PidTerms& PidController::GetTerms() const
+{
+    return m_terms;
+}
+
+RcController::RcController(const PidGains& horizontal,
+                           const PidGains& vertical)
+    : m_horizontal{horizontal}, m_vertical{vertical}
+{
+}
+
+cmd::Rc RcController::Update(const double error_x,
+                             const double error_y,
+                             const std::chrono::steady_clock::time_point time)
+{
+    if (m_start == std::chrono::steady_clock::time_point{})
+    {
+        m_start = time;
+    }
+    const double seconds{
+        m_has_previous
+            ? std::chrono::duration<double>(time - m_previous_time).count()
+            : 0};
+    m_previous_time = time;
+    m_has_previous = true;
+
+    // Outputs are already clamped to the rc range. Rows grow downwards, but
+    // up is positive.
+    const int left_right{
+        static_cast<int>(std::lround(m_horizontal.Update(error_x, seconds)))};
+    const int up_down{
+        -static_cast<int>(std::lround(m_vertical.Update(error_y, seconds)))};
+    const cmd::Rc rc{left_right, 0, up_down, 0};
+
+    const PidTerms& h{m_horizontal.GetTerms()};
+    const PidTerms& v{m_vertical.GetTerms()};
+    CTELLO_DEBUG(
+        "Error ({:.0f}, {:.0f}) PID x ({:.1f}, {:.1f}, {:.1f}) "
+        "y ({:.1f}, {:.1f}, {:.1f}) -> {}",
+        error_x, error_y, h.p, h.i, h.d, v.p, v.i, v.d,
+        static_cast<cmd::Text>(rc).View());
+    if (m_trace.is_open())
+    {
+        const double elapsed{
+            std::chrono::duration<double>(time - m_start).count()};
+        m_trace << elapsed << ',' << error_x << ',' << error_y << ',' << h.p
+                << ',' << h.i << ',' << h.d << ',' << v.p << ',' << v.i << ','
+                << v.d << ',' << left_right << ',' << up_down << '\n';
+    }
+    return rc;
+}
+
+void RcController::Reset()
+{
+    m_horizontal.Reset();
+    m_vertical.Reset();
+    m_has_previous = false;
+}
+
+bool RcController::OpenTrace(const std::string& path)
+{
+    m_trace.open(path);
+    if (!m_trace)
+    {
+        CTELLO_ERROR("open {}: {} ({})", path, errno, strerror(errno));
+        return false;
+    }
+    m_trace << "time,error_x,error_y,p_x,i_x,d_x,p_y,i_y,d_y,left_right,"
+               "up_down\n";
+    return true;
+}
+
+PidController& RcController::GetHorizontal()
+{
+    return m_horizontal;
+}
+
+PidController& RcController::GetVertical()
+{
+    return m_vertical;
+}
+}  // namespace ctello
@@ -0,0 +1,902 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#include "ctello_detector.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CTELLO_X86
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "ctello_internal.h"
+
+namespace
+{
+using ctello::ImageView;
+using ctello::SimdKernel;
+
+// Column counts are accumulated in 16 bits, so they are flushed at least
+// this often.
+const int MAX_ROWS_PER_PASS{65535};
+
+// Bands smaller than this aren't worth a thread.
+const int MIN_ROWS_PER_BAND{64};
+
+// Counts the target pixels of rows [first, last), storing the count of
+// every row and adding up the count of every column.
+using CountFunction = void (*)(const ImageView& image,
+                               int first,
+                               int last,
+                               uint8_t threshold,
+                               uint32_t* rows,
+                               uint16_t* cols);
+
+// Whether a pixel with the given channels is part of the target
+template <int CHANNELS>
+bool IsTarget(const uint8_t* pixel, const uint8_t threshold)
+{
+    if constexpr (CHANNELS == 1)
+    {
+        return pixel[0] > threshold;
+    }
+    else
+    {
+        return pixel[0] > threshold && pixel[1] > threshold &&
+               pixel[2] > threshold;
+    }
+}
+
+// Sets the mask of every pixel of a row, non-zero for target pixels.
+using MaskFunction = void (*)(const uint8_t* row,
+                              int cols,
+                              uint8_t threshold,
+                              uint8_t* mask);
+
+// Counts the target pixels of a row from the given column on.
+template <int CHANNELS>
+uint32_t CountRowTail(const uint8_t* row,
+                      const int first,
+                      const int last,
+                      const uint8_t threshold,
+                      uint16_t* cols)
+{
+    uint32_t count{0};
+    for (int j = first; j < last; ++j)
+    {
+        const bool is_target{
+            IsTarget<CHANNELS>(row + CHANNELS * j, threshold)};
+        count += is_target;
+        cols[j] += is_target;
+    }
+    return count;
+}
+
+template <int CHANNELS>
+void MaskScalar(const uint8_t* row,
+                const int cols,
+                const uint8_t threshold,
+                uint8_t* mask)
+{
+    for (int j = 0; j < cols; ++j)
+    {
+        mask[j] = IsTarget<CHANNELS>(row + CHANNELS * j, threshold);
+    }
+}
+
+template <int CHANNELS>
+void CountScalar(const ImageView& image,
+                 const int first,
+                 const int last,
+                 const uint8_t threshold,
+                 uint32_t* rows,
+                 uint16_t* cols)
+{
+    for (int i = first; i < last; ++i)
+    {
+        rows[i] = CountRowTail<CHANNELS>(image.data + i * image.step, 0,
+                                         image.cols, threshold, cols);
+    }
+}
+
+#ifdef CTELLO_X86
+// pshufb indices gathering the B, G and R bytes of 16 pixels, spread over 3
+// vectors, into one vector per channel (-1 leaves a zero).
+// clang-format off
+alignas(16) const int8_t GATHER[3][3][16] = {
+    {{ 0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  1,  4,  7, 10, 13}},
+    {{ 1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14}},
+    {{ 2,  5,  8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1,  1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15}}};
+// clang-format on
+
+__attribute__((target("ssse3"))) __m128i LoadGather(const int channel,
+                                                      const int part)
+{
+    return _mm_load_si128(
+        reinterpret_cast<const __m128i*>(GATHER[channel][part]));
+}
+
+// 0xff for every byte above the threshold (which is passed plus one).
+__attribute__((target("ssse3"))) __m128i Above(const uint8_t* bytes,
+                                                 const __m128i above)
+{
+    const __m128i values{
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes))};
+    return _mm_cmpeq_epi8(_mm_max_epu8(values, above), values);
+}
+
+// Same for 32 bytes, taking the upper half from the given offset.
+__attribute__((target("avx2"))) __m256i Above(const uint8_t* bytes,
+                                                const int high_offset,
+                                                const __m256i above)
+{
+    const __m256i values{_mm256_inserti128_si256(
+        _mm256_castsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + high_offset)),
+        1)};
+    return _mm256_cmpeq_epi8(_mm256_max_epu8(values, above), values);
+}
+
+// 0xff for every pixel of the 16 given ones that is part of the target, 0
+// for the rest.
+template <int CHANNELS>
+__attribute__((target("ssse3"))) __m128i FindTargets(const uint8_t* pixels,
+                                                       const __m128i above)
+{
+    if constexpr (CHANNELS == 1)
+    {
+        return Above(pixels, above);
+    }
+    else
+    {
+        __m128i masks[3];
+        for (int part = 0; part < 3; ++part)
+        {
+            masks[part] = Above(pixels + 16 * part, above);
+        }
+        __m128i targets{_mm_set1_epi8(-1)};
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            __m128i channel_mask{_mm_setzero_si128()};
+            for (int part = 0; part < 3; ++part)
+            {
+                channel_mask = _mm_or_si128(
+                    channel_mask,
+                    _mm_shuffle_epi8(masks[part], LoadGather(channel, part)));
+            }
+            targets = _mm_and_si128(targets, channel_mask);
+        }
+        return targets;
+    }
+}
+
+// Same as above for 32 pixels, 16 per lane.
+template <int CHANNELS>
+__attribute__((target("avx2"))) __m256i FindTargets(const uint8_t* pixels,
+                                                      const __m256i above)
+{
+    if constexpr (CHANNELS == 1)
+    {
+        return Above(pixels, 16, above);
+    }
+    else
+    {
+        __m256i masks[3];
+        for (int part = 0; part < 3; ++part)
+        {
+            masks[part] = Above(pixels + 16 * part, 48, above);
+        }
+        __m256i targets{_mm256_set1_epi8(-1)};
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            __m256i channel_mask{_mm256_setzero_si256()};
+            for (int part = 0; part < 3; ++part)
+            {
+                const __m256i gather{
+                    _mm256_broadcastsi128_si256(LoadGather(channel, part))};
+                channel_mask = _mm256_or_si256(
+                    channel_mask, _mm256_shuffle_epi8(masks[part], gather));
+            }
+            targets = _mm256_and_si256(targets, channel_mask);
+        }
+        return targets;
+    }
+}
+
+// Adds 16 bytes of 0 or 1 to the column counts, returning the row sum.
+__attribute__((target("ssse3"))) __m128i AddTargets(const __m128i ones,
+                                                      uint16_t* cols,
+                                                      const __m128i row_sum)
+{
+    const __m128i zero{_mm_setzero_si128()};
+    __m128i* const low{reinterpret_cast<__m128i*>(cols)};
+    __m128i* const high{reinterpret_cast<__m128i*>(cols + 8)};
+    _mm_storeu_si128(low, _mm_add_epi16(_mm_loadu_si128(low),
+                                        _mm_unpacklo_epi8(ones, zero)));
+    _mm_storeu_si128(high, _mm_add_epi16(_mm_loadu_si128(high),
+                                         _mm_unpackhi_epi8(ones, zero)));
+    return _mm_add_epi64(row_sum, _mm_sad_epu8(ones, zero));
+}
+
+__attribute__((target("ssse3"))) uint32_t Sum(const __m128i row_sum)
+{
+    return _mm_cvtsi128_si32(row_sum) +
+           _mm_cvtsi128_si32(_mm_srli_si128(row_sum, 8));
+}
+
+template <int CHANNELS>
+__attribute__((target("ssse3"))) void MaskSsse3(const uint8_t* row,
+                                                  const int cols,
+                                                  const uint8_t threshold,
+                                                  uint8_t* mask)
+{
+    const __m128i above{_mm_set1_epi8(static_cast<char>(threshold + 1))};
+    const int vector_cols{cols & ~15};
+    for (int j = 0; j < vector_cols; j += 16)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + j),
+                         FindTargets<CHANNELS>(row + CHANNELS * j, above));
+    }
+    MaskScalar<CHANNELS>(row + CHANNELS * vector_cols, cols - vector_cols,
+                         threshold, mask + vector_cols);
+}
+
+template <int CHANNELS>
+__attribute__((target("avx2"))) void MaskAvx2(const uint8_t* row,
+                                                const int cols,
+                                                const uint8_t threshold,
+                                                uint8_t* mask)
+{
+    const __m256i above{_mm256_set1_epi8(static_cast<char>(threshold + 1))};
+    const int vector_cols{cols & ~31};
+    for (int j = 0; j < vector_cols; j += 32)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(mask + j),
+                            FindTargets<CHANNELS>(row + CHANNELS * j, above));
+    }
+    MaskScalar<CHANNELS>(row + CHANNELS * vector_cols, cols - vector_cols,
+                         threshold, mask + vector_cols);
+}
+
+template <int CHANNELS>
+__attribute__((target("ssse3"))) void CountSsse3(const ImageView& image,
+                                                   const int first,
+                                                   const int last,
+                                                   const uint8_t threshold,
+                                                   uint32_t* rows,
+                                                   uint16_t* cols)
+{
+    const __m128i above{_mm_set1_epi8(static_cast<char>(threshold + 1))};
+    const __m128i one{_mm_set1_epi8(1)};
+    const int vector_cols{image.cols & ~15};
+    for (int i = first; i < last; ++i)
+    {
+        const uint8_t* const row{image.data + i * image.step};
+        __m128i row_sum{_mm_setzero_si128()};
+        for (int j = 0; j < vector_cols; j += 16)
+        {
+            const __m128i targets{
+                FindTargets<CHANNELS>(row + CHANNELS * j, above)};
+            row_sum = AddTargets(_mm_and_si128(targets, one), cols + j,
+                                 row_sum);
+        }
+        rows[i] = Sum(row_sum) + CountRowTail<CHANNELS>(row, vector_cols,
+                                                        image.cols, threshold,
+                                                        cols);
+    }
+}
+
+template <int CHANNELS>
+__attribute__((target("avx2"))) void CountAvx2(const ImageView& image,
+                                                 const int first,
+                                                 const int last,
+                                                 const uint8_t threshold,
+                                                 uint32_t* rows,
+                                                 uint16_t* cols)
+{
+    const __m256i above{_mm256_set1_epi8(static_cast<char>(threshold + 1))};
+    const __m256i one{_mm256_set1_epi8(1)};
+    const __m256i zero{_mm256_setzero_si256()};
+    const int vector_cols{image.cols & ~31};
+    for (int i = first; i < last; ++i)
+    {
+        const uint8_t* const row{image.data + i * image.step};
+        __m256i row_sum{zero};
+        for (int j = 0; j < vector_cols; j += 32)
+        {
+            const __m256i ones{_mm256_and_si256(
+                FindTargets<CHANNELS>(row + CHANNELS * j, above), one)};
+            __m256i* const low{reinterpret_cast<__m256i*>(cols + j)};
+            __m256i* const high{reinterpret_cast<__m256i*>(cols + j + 16)};
+            _mm256_storeu_si256(
+                low, _mm256_add_epi16(
+                         _mm256_loadu_si256(low),
+                         _mm256_cvtepu8_epi16(_mm256_castsi256_si128(ones))));
+            _mm256_storeu_si256(
+                high,
+                _mm256_add_epi16(
+                    _mm256_loadu_si256(high),
+                    _mm256_cvtepu8_epi16(_mm256_extracti128_si256(ones, 1))));
+            row_sum = _mm256_add_epi64(row_sum, _mm256_sad_epu8(ones, zero));
+        }
+        const __m128i half_sum{
+            _mm_add_epi64(_mm256_castsi256_si128(row_sum),
+                          _mm256_extracti128_si256(row_sum, 1))};
+        rows[i] = Sum(half_sum) + CountRowTail<CHANNELS>(row, vector_cols,
+                                                         image.cols, threshold,
+                                                         cols);
+    }
+}
+#endif
+
+SimdKernel GetBestKernel()
+{
+#ifdef CTELLO_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return SimdKernel::AVX2;
+    }
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        return SimdKernel::SSSE3;
+    }
+#endif
+    return SimdKernel::SCALAR;
+}
+
+// The given kernel, or the fastest one supported if the CPU lacks it
+SimdKernel ResolveKernel(const SimdKernel kernel)
+{
+    const SimdKernel best{GetBestKernel()};
+    const SimdKernel resolved{kernel == SimdKernel::BEST
+                                  ? best
+                                  : std::min(kernel, best)};
+    if (resolved != kernel && kernel != SimdKernel::BEST)
+    {
+        CTELLO_WARN("No {} support, using {}", ToString(kernel),
+                    ToString(resolved));
+    }
+    return resolved;
+}
+
+int ResolveThreads(const int threads)
+{
+    return threads > 0 ? threads
+                       : std::max<int>(std::thread::hardware_concurrency(), 1);
+}
+
+template <int CHANNELS>
+CountFunction GetCountFunction(const SimdKernel kernel)
+{
+    switch (kernel)
+    {
+#ifdef CTELLO_X86
+    case SimdKernel::AVX2:
+        return CountAvx2<CHANNELS>;
+    case SimdKernel::SSSE3:
+        return CountSsse3<CHANNELS>;
+#endif
+    default:
+        return CountScalar<CHANNELS>;
+    }
+}
+
+template <int CHANNELS>
+MaskFunction GetMaskFunction(const SimdKernel kernel)
+{
+    switch (kernel)
+    {
+#ifdef CTELLO_X86
+    case SimdKernel::AVX2:
+        return MaskAvx2<CHANNELS>;
+    case SimdKernel::SSSE3:
+        return MaskSsse3<CHANNELS>;
+#endif
+    default:
+        return MaskScalar<CHANNELS>;
+    }
+}
+
+// Part of the region inside an image of the given size
+ctello::Region Clip(const ctello::Region& region,
+                    const int rows,
+                    const int cols)
+{
+    ctello::Region clipped;
+    clipped.row = std::clamp(region.row, 0, rows);
+    clipped.col = std::clamp(region.col, 0, cols);
+    clipped.rows = std::clamp(region.row + region.rows, 0, rows) - clipped.row;
+    clipped.cols = std::clamp(region.col + region.cols, 0, cols) - clipped.col;
+    return clipped;
+}
+
+template <typename T>
+int IndexOfMax(const std::vector<T>& counts)
+{
+    return std::distance(counts.cbegin(),
+                         std::max_element(counts.cbegin(), counts.cend()));
+}
+
+// Root of the run's blob, halving the path to it on the way.
+template <typename Run>
+uint32_t FindRoot(std::vector<Run>& runs, uint32_t index)
+{
+    while (runs[index].parent != index)
+    {
+        runs[index].parent = runs[runs[index].parent].parent;
+        index = runs[index].parent;
+    }
+    return index;
+}
+
+// Joins the blobs of the two runs, the lowest index becoming the root.
+template <typename Run>
+void Unite(std::vector<Run>& runs, const uint32_t a, const uint32_t b)
+{
+    const uint32_t root_a{FindRoot(runs, a)};
+    const uint32_t root_b{FindRoot(runs, b)};
+    if (root_a < root_b)
+    {
+        runs[root_b].parent = root_a;
+    }
+    else if (root_b < root_a)
+    {
+        runs[root_a].parent = root_b;
+    }
+}
+
+// Joins the runs [begin, end) of a row with the ones of the previous row,
+// [previous_begin, previous_end), that touch them, diagonals included. Both
+// are sorted by column.
+template <typename Run>
+void UniteTouching(std::vector<Run>& runs,
+                   std::size_t previous_begin,
+                   const std::size_t previous_end,
+                   const std::size_t begin,
+                   const std::size_t end)
+{
+    for (std::size_t r = begin; r < end; ++r)
+    {
+        const Run run{runs[r]};
+        while (previous_begin < previous_end &&
+               runs[previous_begin].last < run.first - 1)
+        {
+            ++previous_begin;
+        }
+        for (std::size_t p = previous_begin;
+             p < previous_end && runs[p].first <= run.last + 1; ++p)
+        {
+            Unite(runs, r, p);
+        }
+    }
+}
+}  // namespace
+
+namespace ctello
+{
+const char* ToString(const SimdKernel kernel)
+{
+    switch (kernel)
+    {
+    case SimdKernel::SCALAR:
+        return "scalar";
+    case SimdKernel::SSSE3:
+        return "ssse3";
+    case SimdKernel::AVX2:
+        return "avx2";
+    case SimdKernel::BEST:
+        return "best";
+    }
+    return "?";
+}
+
+BrightTargetDetector::BrightTargetDetector(const uint8_t threshold,
+                                           const int threads,
+                                           const SimdKernel kernel)
+    : m_threshold{threshold},
+      m_threads{ResolveThreads(threads)},
+      m_kernel{ResolveKernel(kernel)}
+{
+    if (m_threads > 1)
+    {
+        m_pool = std::make_unique<WorkerPool>(m_threads);
+    }
+}
+
+std::optional<Target> BrightTargetDetector::Find(const ImageView& image)
+{
+    if (image.channels != 1 && image.channels != 3)
+    {
+        CTELLO_ERROR("Expected 1 or 3 channels, got {}", image.channels);
+        return {};
+    }
+    m_rows.assign(image.rows, 0);
+    m_cols.assign(image.cols, 0);
+    // Nothing is above 255.
+    if (m_threshold == 255 || image.rows == 0 || image.cols == 0)
+    {
+        return {};
+    }
+
+    const int bands{
+        std::clamp(image.rows / MIN_ROWS_PER_BAND, 1, m_threads)};
+    m_band_cols16.assign(bands * image.cols, 0);
+    m_band_cols.assign(bands * image.cols, 0);
+    const auto band_start = [&](const int band)
+    { return static_cast<int>(int64_t{image.rows} * band / bands); };
+    const auto count_band = [&](const int band)
+    { CountBand(image, band, band_start(band), band_start(band + 1)); };
+    if (m_pool)
+    {
+        m_pool->Run(bands, count_band);
+    }
+    else
+    {
+        count_band(0);
+    }
+
+    for (int band = 0; band < bands; ++band)
+    {
+        const uint32_t* const cols{&m_band_cols[band * image.cols]};
+        for (int j = 0; j < image.cols; ++j)
+        {
+            m_cols[j] += cols[j];
+        }
+    }
+    Target target;
+    for (const uint32_t count : m_rows)
+    {
+        target.pixels += count;
+    }
+    if (target.pixels == 0)
+    {
+        return {};
+    }
+    target.row = IndexOfMax(m_rows);
+    target.col = IndexOfMax(m_cols);
+    return target;
+}
+
+std::optional<Target> BrightTargetDetector::Find(const ImageView& image,
+                                                 const Region& region)
+{
+    const Region clipped{Clip(region, image.rows, image.cols)};
+    ImageView view{image};
+    view.data += clipped.row * image.step + clipped.col * image.channels;
+    view.rows = clipped.rows;
+    view.cols = clipped.cols;
+    auto target = Find(view);
+    if (target)
+    {
+        target->row += clipped.row;
+        target->col += clipped.col;
+    }
+    return target;
+}
+
+const std::vector<uint32_t>& BrightTargetDetector::GetRowCounts() const
+{
+    return m_rows;
+}
+
+const std::vector<uint32_t>& BrightTargetDetector::GetColCounts() const
+{
+    return m_cols;
+}
+
+SimdKernel BrightTargetDetector::GetKernel() const
+{
+    return m_kernel;
+}
+
+void BrightTargetDetector::CountBand(const ImageView& image,
+                                     const int band,
+                                     const int first,
+                                     const int last)
+{
+    const CountFunction count{image.channels == 1
+                                  ? GetCountFunction<1>(m_kernel)
+                                  : GetCountFunction<3>(m_kernel)};
+    uint16_t* const cols16{&m_band_cols16[band * image.cols]};
+    uint32_t* const cols{&m_band_cols[band * image.cols]};
+    for (int pass = first; pass < last; pass += MAX_ROWS_PER_PASS)
+    {
+        count(image, pass, std::min(pass + MAX_ROWS_PER_PASS, last),
+              m_threshold, m_rows.data(), cols16);
+        for (int j = 0; j < image.cols; ++j)
+        {
+            cols[j] += cols16[j];
+            cols16[j] = 0;
+        }
+    }
+}
+
+TargetTracker::TargetTracker(BrightTargetDetector& detector,
+                             const TrackerOptions& options)
+    : m_detector{detector}, m_options{options}
+{
+    m_options.coarse_stride = std::max(m_options.coarse_stride, 1);
+}
+
+std::optional<Target> TargetTracker::Track(const ImageView& image)
+{
+    std::optional<Target> target;
+    if (m_last)
+    {
+        // Where it would be if it kept moving as in the last frame
+        int row{m_last->row};
+        int col{m_last->col};
+        if (m_previous)
+        {
+            row += m_last->row - m_previous->row;
+            col += m_last->col - m_previous->col;
+        }
+        m_search_region = GetRegionAround(image, row, col);
+        target = m_detector.Find(image, m_search_region);
+        m_stats.tracked += target.has_value();
+    }
+    if (!target)
+    {
+        ++m_stats.coarse_scans;
+        ImageView coarse{image};
+        coarse.rows = (image.rows + m_options.coarse_stride - 1) /
+                      m_options.coarse_stride;
+        coarse.step *= m_options.coarse_stride;
+        m_search_region = {0, 0, image.rows, image.cols};
+        if (const auto hint = m_detector.Find(coarse))
+        {
+            m_search_region = GetRegionAround(
+                image, hint->row * m_options.coarse_stride, hint->col);
+            target = m_detector.Find(image, m_search_region);
+        }
+    }
+
+    m_stats.lost += !target.has_value();
+    m_previous = target ? m_last : std::nullopt;
+    m_last = target;
+    return target;
+}
+
+void TargetTracker::Reset()
+{
+    m_last.reset();
+    m_previous.reset();
+}
+
+Region TargetTracker::GetSearchRegion() const
+{
+    return m_search_region;
+}
+
+TrackerStats TargetTracker::GetStats() const
+{
+    return m_stats;
+}
+
+Region TargetTracker::GetRegionAround(const ImageView& image,
+                                     const int row,
+                                     const int col) const
+{
+    const int radius{m_options.search_radius};
+    const Region region{row - radius, col - radius, 2 * radius + 1,
+                        2 * radius + 1};
+    return Clip(region, image.rows, image.cols);
+}
+
+BlobDetector::BlobDetector(const uint8_t threshold,
+                           const int threads,
+                           const SimdKernel kernel)
+    : m_threshold{threshold},
+      m_threads{ResolveThreads(threads)},
+      m_kernel{ResolveKernel(kernel)}
+{
+    if (m_threads > 1)
+    {
+        m_pool = std::make_unique<WorkerPool>(m_threads);
+    }
+}
+
+const std::vector<Blob>& BlobDetector::Find(const ImageView& image,
+                                            const int min_area)
+{
+    m_blobs.clear();
+    if (image.channels != 1 && image.channels != 3)
+    {
+        CTELLO_ERROR("Expected 1 or 3 channels, got {}", image.channels);
+        return m_blobs;
+    }
+    // Nothing is above 255.
+    if (m_threshold == 255 || image.rows == 0 || image.cols == 0)
+    {
+        return m_blobs;
+    }
+
+    // Every band is labelled on its own...
+    const int bands{
+        std::clamp(image.rows / MIN_ROWS_PER_BAND, 1, m_threads)};
+    m_bands.resize(std::max<std::size_t>(m_bands.size(), bands));
+    const auto band_start = [&](const int band)
+    { return static_cast<int>(int64_t{image.rows} * band / bands); };
+    const auto label_band = [&](const int band)
+    {
+        LabelBand(image, m_bands[band], band_start(band),
+                  band_start(band + 1));
+    };
+    if (m_pool)
+    {
+        m_pool->Run(bands, label_band);
+    }
+    else
+    {
+        label_band(0);
+    }
+
+    // ...and then joined with the last row of the previous one.
+    m_runs.clear();
+    std::size_t previous_begin{0};
+    for (int band = 0; band < bands; ++band)
+    {
+        const std::size_t offset{m_runs.size()};
+        for (Run run : m_bands[band].runs)
+        {
+            run.parent += offset;
+            m_runs.push_back(run);
+        }
+        std::size_t first_row_end{offset};
+        while (first_row_end < m_runs.size() &&
+               m_runs[first_row_end].row == band_start(band))
+        {
+            ++first_row_end;
+        }
+        if (previous_begin < offset &&
+            m_runs[previous_begin].row == band_start(band) - 1)
+        {
+            UniteTouching(m_runs, previous_begin, offset, offset,
+                          first_row_end);
+        }
+        // Runs of the last row of this band
+        previous_begin = m_runs.size();
+        while (previous_begin > offset &&
+               m_runs[previous_begin - 1].row == m_runs.back().row)
+        {
+            --previous_begin;
+        }
+    }
+
+    // Every run adds up to the blob of its root.
+    m_blob_indices.assign(m_runs.size(), -1);
+    for (uint32_t r = 0; r < m_runs.size(); ++r)
+    {
+        const Run& run{m_runs[r]};
+        int& index{m_blob_indices[FindRoot(m_runs, r)]};
+        if (index == -1)
+        {
+            index = m_blobs.size();
+            m_blobs.push_back({0, {run.row, run.first, 0, 0}, 0, 0});
+        }
+        Blob& blob{m_blobs[index]};
+        const int length{run.last - run.first + 1};
+        blob.area += length;
+        // Sums for now, means at the end
+        blob.row += static_cast<double>(run.row) * length;
+        blob.col += (run.first + run.last) * length / 2.0;
+        Region& bounds{blob.bounds};
+        // The bottom right corner, for now
+        const int last_col{std::max(bounds.col + bounds.cols, run.last + 1)};
+        bounds.col = std::min(bounds.col, run.first);
+        bounds.cols = last_col - bounds.col;
+        bounds.rows = run.row + 1 - bounds.row;
+    }
+
+    m_blobs.erase(std::remove_if(m_blobs.begin(), m_blobs.end(),
+                                 [min_area](const Blob& blob)
+                                 { return blob.area < min_area; }),
+                  m_blobs.end());
+    for (Blob& blob : m_blobs)
+    {
+        blob.row /= blob.area;
+        blob.col /= blob.area;
+    }
+    std::sort(m_blobs.begin(), m_blobs.end(),
+              [](const Blob& a, const Blob& b) { return a.area > b.area; });
+    return m_blobs;
+}
+
+const std::vector<Blob>& BlobDetector::Find(const ImageView& image,
+                                            const Region& region,
+                                            const int min_area)
+{
+    const Region clipped{Clip(region, image.rows, image.cols)};
+    ImageView view{image};
+    view.data += clipped.row * image.step + clipped.col * image.channels;
+    view.rows = clipped.rows;
+    view.cols = clipped.cols;
+    Find(view, min_area);
+    for (Blob& blob : m_blobs)
+    {
+        blob.bounds.row += clipped.row;
+        blob.bounds.col += clipped.col;
+        blob.row += clipped.row;
+        blob.col += clipped.col;
+    }
+    return m_blobs;
+}
+
+SimdKernel BlobDetector::GetKernel() const
+{
+    return m_kernel;
+}
+
+void BlobDetector::LabelBand(const ImageView& image,
+                             Band& band,
+                             const int first,
+                             const int last)
+{
+    const MaskFunction mask_row{image.channels == 1
+                                    ? GetMaskFunction<1>(m_kernel)
+                                    : GetMaskFunction<3>(m_kernel)};
+    band.runs.clear();
+    // Room to look at the mask 8 bytes at a time
+    band.mask.assign(image.cols + sizeof(uint64_t), 0);
+    uint8_t* const mask{band.mask.data()};
+    std::size_t previous_begin{0};
+    for (int i = first; i < last; ++i)
+    {
+        mask_row(image.data + i * image.step, image.cols, m_threshold, mask);
+        const std::size_t begin{band.runs.size()};
+        int j{0};
+        while (j < image.cols)
+        {
+            uint64_t word;
+            std::memcpy(&word, mask + j, sizeof(word));
+            if (word == 0)
+            {
+                // Skip the background quickly.
+                j += sizeof(word);
+                continue;
+            }
+            if (!mask[j])
+            {
+                ++j;
+                continue;
+            }
+            const int run_first{j};
+            while (j < image.cols && mask[j])
+            {
+                ++j;
+            }
+            const auto index = static_cast<uint32_t>(band.runs.size());
+            band.runs.push_back({i, run_first, j - 1, index});
+        }
+        UniteTouching(band.runs, previous_begin, begin, begin,
+                      band.runs.size());
+        previous_begin = begin;
+    }
+}
+}  // namespace ctello
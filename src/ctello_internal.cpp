@@ -0,0 +1,214 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#include "ctello_internal.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <memory.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <sstream>
+#include <unordered_map>
+
+#include "spdlog/spdlog.h"
+
+namespace ctello::internal
+{
+// Reads the spdlog level from the given environment variable name.
+spdlog::level::level_enum GetLogLevelFromEnv(const std::string& var_name)
+{
+    // clang-format off
+    std::unordered_map<std::string, spdlog::level::level_enum> name_to_enum = {
+        {"trace", spdlog::level::trace},
+        {"debug", spdlog::level::debug},
+        {"info", spdlog::level::info},
+        {"warn", spdlog::level::warn},
+        {"error", spdlog::level::err},
+        {"critical", spdlog::level::critical},
+        {"off", spdlog::level::off}
+    };
+    // clang-format on
+    const char* const name_c_str = std::getenv(var_name.c_str());
+    if (!name_c_str)
+    {
+        // Info is the default
+        return spdlog::level::info;
+    }
+    const std::string name{name_c_str};
+    return name_to_enum[name];
+}
+
+// Binds the given socket file descriptor ot the given port.
+// Returns whether it succeeds or not and the error message.
+std::pair<bool, std::string> BindSocketToPort(const int sockfd, const int port)
+{
+    sockaddr_in listen_addr{};
+    // htons converts from host byte order to network byte order.
+    listen_addr.sin_port = htons(port);
+    listen_addr.sin_addr.s_addr = INADDR_ANY;
+    listen_addr.sin_family = AF_INET;
+    int result = bind(sockfd, reinterpret_cast<sockaddr*>(&listen_addr),
+                      sizeof(listen_addr));
+
+    if (result == -1)
+    {
+        std::stringstream ss;
+        ss << "bind to " << port << ": " << errno;
+        ss << " (" << strerror(errno) << ")";
+        return {false, ss.str()};
+    }
+
+    return {true, ""};
+}
+
+// Finds the socket address given an ip and a port.
+// Returns whether it succeeds or not and the error message.
+std::pair<bool, std::string> FindSocketAddr(const char* const ip,
+                                            const char* const port,
+                                            sockaddr_storage* const addr)
+{
+    addrinfo* result_list{nullptr};
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    int result = getaddrinfo(ip, port, &hints, &result_list);
+
+    if (result)
+    {
+        std::stringstream ss;
+        ss << "getaddrinfo: " << result;
+        ss << " (" << gai_strerror(result) << ") ";
+        return {false, ss.str()};
+    }
+
+    memcpy(addr, result_list->ai_addr, result_list->ai_addrlen);
+    freeaddrinfo(result_list);
+
+    return {true, ""};
+}
+
+// Sends a string of bytes to the given destination address.
+// Returns the number of sent bytes and, if -1, the error message.
+std::pair<int, std::string> SendTo(const int sockfd,
+                                   sockaddr_storage& dest_addr,
+                                   const std::string_view message)
+{
+    const socklen_t addr_len{sizeof(dest_addr)};
+    int result = sendto(sockfd, message.data(), message.size(), 0,
+                        reinterpret_cast<sockaddr*>(&dest_addr), addr_len);
+
+    if (result == -1)
+    {
+        std::stringstream ss;
+        ss << "sendto: " << errno;
+        ss << " (" << strerror(errno) << ")";
+        return {-1, ss.str()};
+    }
+
+    return {result, ""};
+}
+
+// Receives a text response into the given buffer, truncated to its size,
+// and the address of the sender into addr.
+// Returns the number of received bytes and, if -1, the error message.
+std::pair<int, std::string> ReceiveFrom(const int sockfd,
+                                        sockaddr_storage& addr,
+                                        char* const buffer,
+                                        const std::size_t size,
+                                        const int flags)
+{
+    socklen_t addr_len{sizeof(addr)};
+    // MSG_DONTWAIT -> Non-blocking
+    // recvfrom is storing (re-populating) the sender address in addr.
+    int result = recvfrom(sockfd, buffer, size, flags,
+                          reinterpret_cast<sockaddr*>(&addr), &addr_len);
+    // Nothing to receive isn't worth an error message.
+    if (result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+        return {-1, {}};
+    }
+    if (result == -1)
+    {
+        std::stringstream ss;
+        ss << "recvfrom: " << errno;
+        ss << " (" << strerror(errno) << ")";
+        return {-1, ss.str()};
+    }
+
+    return {result, ""};
+}
+
+// Registers the given socket file descriptor for read events.
+// Returns whether it succeeds or not and the error message.
+std::pair<bool, std::string> AddToEpoll(const int epoll_fd, const int sockfd)
+{
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = sockfd;
+    int result = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sockfd, &event);
+
+    if (result == -1)
+    {
+        std::stringstream ss;
+        ss << "epoll_ctl: " << errno;
+        ss << " (" << strerror(errno) << ")";
+        return {false, ss.str()};
+    }
+
+    return {true, ""};
+}
+
+// Time left until the deadline, rounded up so we never wait 0 ms while
+// there is still time left. Negative timeouts mean no deadline at all.
+std::chrono::milliseconds TimeLeft(
+    const std::chrono::milliseconds timeout,
+    const std::chrono::steady_clock::time_point deadline)
+{
+    if (timeout.count() < 0)
+    {
+        return timeout;
+    }
+    const auto left = std::chrono::ceil<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    return std::max(left, std::chrono::milliseconds{0});
+}
+
+// Bumps the counter of the given eventfd, waking up whoever is polling it.
+void Signal(const int event_fd)
+{
+    const uint64_t one{1};
+    if (write(event_fd, &one, sizeof(one)) == -1)
+    {
+        CTELLO_ERROR("write eventfd: {} ({})", errno, strerror(errno));
+    }
+}
+
+// Resets the counter of the given (non-blocking) eventfd.
+void ClearSignal(const int event_fd)
+{
+    uint64_t count;
+    while (read(event_fd, &count, sizeof(count)) > 0)
+        ;
+}
+}  // namespace ctello::internal
@@ -0,0 +1,109 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#pragma once
+
+// Helpers shared by the library sources. Not installed.
+
+#include <sys/socket.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "spdlog/spdlog.h"
+
+// Log calls of the library. Levels below SPDLOG_ACTIVE_LEVEL (set from
+// CTELLO_LOG_LEVEL in CMake) are compiled out, arguments included, and the
+// rest are only formatted if their level is enabled at run time.
+#define CTELLO_LOGGER_TRACE(logger, ...) \
+    SPDLOG_LOGGER_TRACE(logger, __VA_ARGS__)
+#define CTELLO_LOGGER_DEBUG(logger, ...) \
+    SPDLOG_LOGGER_DEBUG(logger, __VA_ARGS__)
+#define CTELLO_LOGGER_INFO(logger, ...) \
+    SPDLOG_LOGGER_INFO(logger, __VA_ARGS__)
+#define CTELLO_LOGGER_WARN(logger, ...) \
+    SPDLOG_LOGGER_WARN(logger, __VA_ARGS__)
+#define CTELLO_LOGGER_ERROR(logger, ...) \
+    SPDLOG_LOGGER_ERROR(logger, __VA_ARGS__)
+
+#define CTELLO_TRACE(...) \
+    CTELLO_LOGGER_TRACE(::ctello::internal::GetLogger(), __VA_ARGS__)
+#define CTELLO_DEBUG(...) \
+    CTELLO_LOGGER_DEBUG(::ctello::internal::GetLogger(), __VA_ARGS__)
+#define CTELLO_INFO(...) \
+    CTELLO_LOGGER_INFO(::ctello::internal::GetLogger(), __VA_ARGS__)
+#define CTELLO_WARN(...) \
+    CTELLO_LOGGER_WARN(::ctello::internal::GetLogger(), __VA_ARGS__)
+#define CTELLO_ERROR(...) \
+    CTELLO_LOGGER_ERROR(::ctello::internal::GetLogger(), __VA_ARGS__)
+
+namespace ctello::internal
+{
+// Reads the spdlog level from the given environment variable name.
+spdlog::level::level_enum GetLogLevelFromEnv(const std::string& var_name);
+
+// Logger of the library, created on first use (see ctello_log.h).
+spdlog::logger* GetLogger();
+// Another logger writing through the same background thread, with the level
+// given to SetLogLevel().
+std::shared_ptr<spdlog::logger> CreateLogger(const std::string& name);
+
+// Binds the given socket file descriptor ot the given port.
+// Returns whether it succeeds or not and the error message.
+std::pair<bool, std::string> BindSocketToPort(int sockfd, int port);
+
+// Finds the socket address given an ip and a port.
+// Returns whether it succeeds or not and the error message.
+std::pair<bool, std::string> FindSocketAddr(const char* ip,
+                                            const char* port,
+                                            sockaddr_storage* addr);
+
+// Sends a string of bytes to the given destination address.
+// Returns the number of sent bytes and, if -1, the error message.
+std::pair<int, std::string> SendTo(int sockfd,
+                                   sockaddr_storage& dest_addr,
+                                   std::string_view message);
+
+// Receives a text response into the given buffer, truncated to its size,
+// and the address of the sender into addr.
+// Returns the number of received bytes and, if -1, the error message.
+std::pair<int, std::string> ReceiveFrom(int sockfd,
+                                        sockaddr_storage& addr,
+                                        char* buffer,
+                                        std::size_t size,
+                                        int flags = MSG_DONTWAIT);
+
+// Registers the given socket file descriptor for read events.
+// Returns whether it succeeds or not and the error message.
+std::pair<bool, std::string> AddToEpoll(int epoll_fd, int sockfd);
+
+// Time left until the deadline, rounded up so we never wait 0 ms while
+// there is still time left. Negative timeouts mean no deadline at all.
+std::chrono::milliseconds TimeLeft(
+    std::chrono::milliseconds timeout,
+    std::chrono::steady_clock::time_point deadline);
+
+// Bumps the counter of the given eventfd, waking up whoever is polling it.
+void Signal(int event_fd);
+
+// Resets the counter of the given (non-blocking) eventfd.
+void ClearSignal(int event_fd);
+}  // namespace ctello::internal
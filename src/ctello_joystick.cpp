@@ -17,20 +17,169 @@
 //  You can contact the author via carlospzlz@gmail.com
 
 #include <fcntl.h>
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
 #include <unistd.h>
 #include <cmath>
 #include <linux/joystick.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
 #include <optional>
+#include <vector>
 
 #include "ctello.h"
 
 static constexpr char INPUT_DEVICE_NAME[]{"/dev/input/js0"};
 static constexpr int MAX_AXIS_VALUE{32767};
 static constexpr int AXIS_SCALE{30};
+// Stick deflection (%) ignored around the centre in rc mode
+static constexpr int RC_DEADZONE{5};
+static constexpr double DEFAULT_RC_RATE{20};
+// Rate at which discrete commands are repeated while a stick is held
+static constexpr double MOVE_RATE{50};
+// Seconds between latency reports
+static constexpr int STATS_PERIOD{5};
+
+// clang-format off
+static constexpr char USAGE[] =
+"Usage: ctello-joystick [OPTIONS]\n"
+"\n"
+"Flies Tello with a DualShock 4 controller.\n"
+"\n"
+"  -d, --device PATH Joystick device               [/dev/input/js0]\n"
+"  -c, --rc          Continuous control, sending the four sticks as a\n"
+"                    single \"rc\" command at a fixed rate\n"
+"  -r, --rate HZ     Rate of the \"rc\" commands                  [20]\n"
+"  -s, --stats       Report the latency from joystick events to the\n"
+"                    commands which carry them being sent\n"
+"  -h, --help        Show this help\n";
+// clang-format on
 
 using ctello::Tello;
+namespace cmd = ctello::cmd;
+
+std::atomic<bool> g_running{true};
+
+void Stop(int)
+{
+    g_running = false;
+}
+
+// Microseconds of CLOCK_MONOTONIC
+int64_t NowUs()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+// Buttons are carried by actions and sticks by moves or "rc" commands.
+enum class Control
+{
+    BUTTON,
+    STICK,
+};
+
+// Latency from joystick events to the sendto() of the command which carries
+// them. Events are timestamped by the kernel (js_event.time) in ms of a
+// clock we can't read, so its offset to CLOCK_MONOTONIC is taken from the
+// event read the soonest, which is assumed to be read right away.
+class LatencyStats
+{
+public:
+    void OnEvent(const uint32_t time, const Control control)
+    {
+        const int64_t now{NowUs()};
+        m_min_offset = std::min(m_min_offset, Offset(now, time));
+        GetPending(control).push_back({time, now});
+    }
+
+    // Every pending event of the control is carried by the command just
+    // sent.
+    void OnSend(const Control control)
+    {
+        const int64_t now{NowUs()};
+        std::vector<Event>& pending{GetPending(control)};
+        for (const auto& event : pending)
+        {
+            m_event_to_send.push_back(Offset(now, event.time));
+            m_read_to_send.push_back(now - event.read);
+        }
+        pending.clear();
+    }
+
+    void Print(std::ostream& os)
+    {
+        if (m_event_to_send.empty())
+        {
+            return;
+        }
+        for (auto& sample : m_event_to_send)
+        {
+            sample -= m_min_offset;
+        }
+        os << "Latency of " << m_event_to_send.size() << " events (ms)"
+           << std::endl;
+        PrintPercentiles(os, "event to sendto", m_event_to_send);
+        PrintPercentiles(os, "read to sendto", m_read_to_send);
+        m_event_to_send.clear();
+        m_read_to_send.clear();
+    }
+
+private:
+    struct Event
+    {
+        uint32_t time;
+        int64_t read;
+    };
+
+    std::vector<Event>& GetPending(const Control control)
+    {
+        return m_pending[static_cast<int>(control)];
+    }
+
+    // Microseconds from the event time to 'now', plus the unknown offset
+    // between both clocks. Event times wrap around every 49 days.
+    static int64_t Offset(const int64_t now, const uint32_t time)
+    {
+        const uint32_t ms{static_cast<uint32_t>(now / 1000) - time};
+        return ms * 1000LL + now % 1000;
+    }
+
+    static void PrintPercentiles(std::ostream& os,
+                                 const char* const name,
+                                 std::vector<int64_t>& samples)
+    {
+        std::sort(samples.begin(), samples.end());
+        const auto at = [&](const double p)
+        {
+            const auto index =
+                static_cast<std::size_t>(p * (samples.size() - 1));
+            return samples[index] / 1000.0;
+        };
+        os << "  " << std::left << std::setw(16) << name << std::right
+           << std::fixed << std::setprecision(2) << "p50 " << at(0.5)
+           << "  p90 " << at(0.9) << "  p99 " << at(0.99) << "  max "
+           << at(1) << std::endl;
+    }
+
+private:
+    std::array<std::vector<Event>, 2> m_pending;
+    std::vector<int64_t> m_event_to_send;
+    std::vector<int64_t> m_read_to_send;
+    int64_t m_min_offset{INT64_MAX};
+};
 
 class Joystick
 {
@@ -40,39 +189,80 @@ public:
         m_fd = open(m_input_device.c_str(), O_RDONLY | O_NONBLOCK);
     }
 
-    void ProcessEvents()
+    ~Joystick()
+    {
+        close(m_fd);
+    }
+
+    int GetFd() const
+    {
+        return m_fd;
+    }
+
+    // Returns false once the device is gone. Only the events which change
+    // the commands to send, in rc mode or not, are passed on to the stats,
+    // as the others are never carried by any command.
+    bool ProcessEvents(const bool rc, LatencyStats* const stats = nullptr)
     {
         js_event event;
-        while (read(m_fd, &event, sizeof(event)) != -1)
+        ssize_t bytes;
+        while ((bytes = read(m_fd, &event, sizeof(event))) == sizeof(event))
         {
+            // The initial state of the controls doesn't carry any latency.
+            const bool initial{(event.type & JS_EVENT_INIT) != 0};
             event.type &= ~JS_EVENT_INIT;
 
             if (event.type == JS_EVENT_BUTTON && event.value == 1)
             {
-                ProcessButtonEvent(event.number);
+                if (ProcessButtonEvent(event.number) && stats && !initial)
+                {
+                    stats->OnEvent(event.time, Control::BUTTON);
+                }
             }
             else if (event.type == JS_EVENT_AXIS)
             {
-                ProcessAxisEvent(event.number, event.value);
+                if (ProcessAxisEvent(event.number, event.value, rc) &&
+                    stats && !initial)
+                {
+                    stats->OnEvent(event.time, Control::STICK);
+                }
             }
         }
+        return bytes == -1 && errno == EAGAIN;
     }
 
-    std::optional<std::string> GetCmd()
+    // Takeoff, land and flips, sent as soon as they are pressed.
+    std::optional<cmd::Text> GetActionCmd()
     {
-        std::string cmd;
-        if (!m_action_cmd.empty())
-        {
-            std::swap(m_action_cmd, cmd);
-            return cmd;
-        }
+        std::optional<cmd::Text> action;
+        std::swap(m_action_cmd, action);
+        return action;
+    }
+
+    // Discrete manoeuvre of the stick being held ("cw 30", ...)
+    const std::optional<cmd::Text>& GetMoveCmd() const
+    {
+        return m_move_cmd;
+    }
 
-        if (!m_move_cmd.empty())
+    // The manoeuvre, only if it changed since the last call, so it can be
+    // sent right away.
+    std::optional<cmd::Text> GetNewMoveCmd()
+    {
+        if (!m_move_changed)
         {
-            return m_move_cmd;
+            return {};
         }
+        m_move_changed = false;
+        return m_move_cmd;
+    }
 
-        return {};
+    // The latest position of the four sticks as "rc a b c d", so events in
+    // between two commands are coalesced.
+    cmd::Rc GetRcCmd() const
+    {
+        return {RcValue(DS4_AXIS::R3_X), -RcValue(DS4_AXIS::R3_Y),
+                -RcValue(DS4_AXIS::L3_Y), RcValue(DS4_AXIS::L3_X)};
     }
 
 private:
@@ -98,109 +288,344 @@ private:
     };
 
 private:
-    void ProcessButtonEvent(uint8_t number)
+    // Returns whether it's an action.
+    bool ProcessButtonEvent(uint8_t number)
     {
         switch (number)
         {
         case DS4_BUTTONS::TRIANGLE:
         {
-            m_action_cmd = "takeoff";
+            m_action_cmd = cmd::Takeoff{};
             break;
         }
         case DS4_BUTTONS::CROSS:
         {
-            m_action_cmd = "land";
+            m_action_cmd = cmd::Land{};
             break;
         }
         case DS4_BUTTONS::L1:
         {
-            m_action_cmd = "flip l";
+            m_action_cmd = cmd::Flip{cmd::Direction::LEFT};
             break;
         }
         case DS4_BUTTONS::R1:
         {
-            m_action_cmd = "flip r";
+            m_action_cmd = cmd::Flip{cmd::Direction::RIGHT};
             break;
         }
         case DS4_BUTTONS::L2:
         {
-            m_action_cmd = "flip b";
+            m_action_cmd = cmd::Flip{cmd::Direction::BACK};
             break;
         }
         case DS4_BUTTONS::R2:
         {
-            m_action_cmd = "flip f";
+            m_action_cmd = cmd::Flip{cmd::Direction::FORWARD};
             break;
         }
+        default:
+            return false;
         }
+        return true;
     }
 
-    void ProcessAxisEvent(const uint8_t number, const int16_t value)
+    // Returns whether the command to send changed: the four sticks in rc
+    // mode, or otherwise the manoeuvre, unless there is none any more.
+    bool ProcessAxisEvent(const uint8_t number,
+                          const int16_t value,
+                          const bool rc)
     {
+        if (rc)
+        {
+            if (number >= m_axes.size() || number == DS4_AXIS::L2_AXIS)
+            {
+                return false;
+            }
+            const auto axis = static_cast<DS4_AXIS>(number);
+            const int previous{RcValue(axis)};
+            m_axes[number] = value;
+            return RcValue(axis) != previous;
+        }
+
         if (!value)
         {
-            m_move_cmd.clear();
-            return;
+            m_move_cmd.reset();
+            return false;
         }
+        const std::optional<cmd::Text> previous{m_move_cmd};
 
-        std::string cmd;
+        // From 20 to 20 + AXIS_SCALE, in range for every manoeuvre
+        const auto val = static_cast<int>(
+            round(20 + fabs(value / float(MAX_AXIS_VALUE)) * AXIS_SCALE));
         switch (number)
         {
         case DS4_AXIS::L3_X:
         {
-            cmd = value > 0 ? "cw" : "ccw";
+            m_move_cmd = value > 0 ? cmd::Text{cmd::Cw{val}}
+                                   : cmd::Text{cmd::Ccw{val}};
             break;
         }
         case DS4_AXIS::L3_Y:
         {
-            cmd = value > 0 ? "down" : "up";
+            m_move_cmd = value > 0 ? cmd::Text{cmd::Down{val}}
+                                   : cmd::Text{cmd::Up{val}};
             break;
         }
         case DS4_AXIS::R3_X:
         {
-            cmd = value > 0 ? "right" : "left";
+            m_move_cmd = value > 0 ? cmd::Text{cmd::Right{val}}
+                                   : cmd::Text{cmd::Left{val}};
             break;
         }
         case DS4_AXIS::R3_Y:
         {
-            cmd = value > 0 ? "back" : "forward";
+            m_move_cmd = value > 0 ? cmd::Text{cmd::Back{val}}
+                                   : cmd::Text{cmd::Forward{val}};
             break;
         }
         }
+        const bool changed{m_move_cmd &&
+                           (!previous ||
+                            previous->View() != m_move_cmd->View())};
+        m_move_changed = m_move_changed || changed;
+        return changed;
+    }
 
-        auto val = static_cast<int>(
-            round(20 + fabs(value / float(MAX_AXIS_VALUE)) * AXIS_SCALE));
-        m_move_cmd = cmd + " " + std::to_string(val);
+    // Axis position in [-100, 100]
+    int RcValue(const DS4_AXIS axis) const
+    {
+        const int value{static_cast<int>(
+            round(m_axes[axis] * 100.0 / MAX_AXIS_VALUE))};
+        return abs(value) < RC_DEADZONE ? 0 : value;
     }
 
 private:
     std::string m_input_device;
     int m_fd;
-    std::string m_action_cmd;
-    std::string m_move_cmd;
+    std::optional<cmd::Text> m_action_cmd;
+    std::optional<cmd::Text> m_move_cmd;
+    bool m_move_changed{false};
+    std::array<int16_t, DS4_AXIS::R3_Y + 1> m_axes{};
 };
 
-int main()
+// (Re)starts a periodic timer, whose first tick is a period from now.
+bool StartTimer(const int timer_fd, const double rate)
 {
-    Tello tello{};
-    if (!tello.Bind())
+    const auto period = static_cast<long>(1E9 / rate);
+    itimerspec spec{};
+    spec.it_interval.tv_sec = period / 1000000000;
+    spec.it_interval.tv_nsec = period % 1000000000;
+    spec.it_value = spec.it_interval;
+    return timerfd_settime(timer_fd, 0, &spec, nullptr) == 0;
+}
+
+// Creates a periodic timer. It doesn't drift however long it takes to
+// handle each tick.
+int CreateTimer(const double rate)
+{
+    const int timer_fd{timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK)};
+    if (timer_fd == -1 || !StartTimer(timer_fd, rate))
     {
-        return 0;
+        std::cerr << "timerfd: " << strerror(errno) << std::endl;
+        close(timer_fd);
+        return -1;
     }
+    return timer_fd;
+}
 
-    Joystick joystick{INPUT_DEVICE_NAME};
-    while (true)
+void Send(Tello& tello,
+          const cmd::Text& command,
+          const Control control,
+          LatencyStats* const stats)
+{
+    tello.SendCommand(command);
+    if (stats)
     {
-        joystick.ProcessEvents();
+        stats->OnSend(control);
+    }
+}
 
-        if (const auto cmd = joystick.GetCmd())
+// Reacts to the joystick, the timer and Tello in a single epoll loop, so
+// nothing waits for the next poll.
+//
+// Buttons are sent as soon as they are pressed. With "rc", the four sticks
+// are sent at once on every tick of the timer, with their latest position.
+// Otherwise, the manoeuvre of the stick being held is sent as soon as it
+// changes, and repeated on every tick.
+int Run(Tello& tello,
+        Joystick& joystick,
+        const bool rc,
+        const double rate,
+        LatencyStats* const stats)
+{
+    const int timer_fd{CreateTimer(rc ? rate : MOVE_RATE)};
+    if (timer_fd == -1)
+    {
+        return 1;
+    }
+    const int epoll_fd{epoll_create1(0)};
+    if (epoll_fd == -1)
+    {
+        std::cerr << "epoll: " << strerror(errno) << std::endl;
+        close(timer_fd);
+        return 1;
+    }
+    for (const int fd : {joystick.GetFd(), timer_fd, tello.GetPollFd()})
+    {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1)
         {
-            tello.SendCommand(*cmd);
+            std::cerr << "epoll: " << strerror(errno) << std::endl;
+            close(epoll_fd);
+            close(timer_fd);
+            return 1;
         }
+    }
 
-        // Sleep for 20ms
-        usleep(2E4);
+    auto next_report = std::chrono::steady_clock::now();
+    std::array<epoll_event, 3> events;
+    while (g_running)
+    {
+        const int count{epoll_wait(epoll_fd, events.data(), events.size(), -1)};
+        if (count == -1 && errno != EINTR)
+        {
+            std::cerr << "epoll: " << strerror(errno) << std::endl;
+            break;
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            const int fd{events[i].data.fd};
+            if (fd == joystick.GetFd())
+            {
+                if (!joystick.ProcessEvents(rc, stats))
+                {
+                    std::cerr << "Joystick disconnected" << std::endl;
+                    g_running = false;
+                }
+                if (const auto cmd = joystick.GetActionCmd())
+                {
+                    Send(tello, *cmd, Control::BUTTON, stats);
+                }
+                if (const auto cmd = joystick.GetNewMoveCmd())
+                {
+                    Send(tello, *cmd, Control::STICK, stats);
+                    // Repeated a whole period later
+                    StartTimer(timer_fd, MOVE_RATE);
+                }
+            }
+            else if (fd == timer_fd)
+            {
+                uint64_t expirations{0};
+                if (read(timer_fd, &expirations, sizeof(expirations)) > 0 &&
+                    expirations > 1 && rc)
+                {
+                    std::cerr << "Missed " << expirations - 1 << " rc ticks"
+                              << std::endl;
+                }
+                if (rc)
+                {
+                    Send(tello, joystick.GetRcCmd(), Control::STICK, stats);
+                }
+                else if (const auto cmd = joystick.GetMoveCmd())
+                {
+                    Send(tello, *cmd, Control::STICK, stats);
+                }
+                if (stats && std::chrono::steady_clock::now() >= next_report)
+                {
+                    stats->Print(std::cout);
+                    next_report = std::chrono::steady_clock::now() +
+                                  std::chrono::seconds{STATS_PERIOD};
+                }
+            }
+            else
+            {
+                // "rc" isn't answered, but everything else is.
+                while (const auto response = tello.ReceiveResponse())
+                {
+                    std::cout << "Tello: " << *response << std::endl;
+                }
+                ctello::TelloState state;
+                while (tello.GetState(state))
+                    ;
+            }
+        }
     }
 
+    if (stats)
+    {
+        stats->Print(std::cout);
+    }
+    close(epoll_fd);
+    close(timer_fd);
     return 0;
 }
+
+int main(const int argc, char* const args[])
+{
+    // clang-format off
+    const option long_options[] = {
+        {"device", required_argument, nullptr, 'd'},
+        {"rc",     no_argument,       nullptr, 'c'},
+        {"rate",   required_argument, nullptr, 'r'},
+        {"stats",  no_argument,       nullptr, 's'},
+        {"help",   no_argument,       nullptr, 'h'},
+        {nullptr,  0,                 nullptr, 0}
+    };
+    // clang-format on
+
+    std::string device{INPUT_DEVICE_NAME};
+    bool rc{false};
+    double rate{DEFAULT_RC_RATE};
+    bool stats{false};
+    int opt;
+    while ((opt = getopt_long(argc, args, "d:cr:sh", long_options, nullptr)) !=
+           -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            device = optarg;
+            break;
+        case 'c':
+            rc = true;
+            break;
+        case 'r':
+            rate = std::atof(optarg);
+            break;
+        case 's':
+            stats = true;
+            break;
+        case 'h':
+            std::cout << USAGE;
+            return 0;
+        default:
+            std::cerr << USAGE;
+            return 1;
+        }
+    }
+    if (rate <= 0)
+    {
+        std::cerr << "Invalid rate: " << rate << std::endl;
+        return 1;
+    }
+
+    Joystick joystick{device};
+    if (joystick.GetFd() == -1)
+    {
+        std::cerr << device << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    Tello tello{};
+    if (!tello.Bind())
+    {
+        return 0;
+    }
+
+    signal(SIGINT, Stop);
+    signal(SIGTERM, Stop);
+    LatencyStats latency_stats;
+    return Run(tello, joystick, rc, rate, stats ? &latency_stats : nullptr);
+}
@@ -0,0 +1,233 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#include "ctello_log.h"
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "ctello_internal.h"
+#include "ctello_sync.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+
+namespace
+{
+const char* const LOG_PATTERN = "[%D %T] [%n] [%^%l%$] %v";
+
+// Messages waiting to be written, and how much of every message and logger
+// name is kept
+const std::size_t LOG_RING_CAPACITY{1024};
+const std::size_t LOG_MESSAGE_SIZE{256};
+const std::size_t LOGGER_NAME_SIZE{48};
+
+// The writer looks at the ring at least this often, in case it missed a
+// wake up.
+const std::chrono::milliseconds LOG_IDLE_PERIOD{50};
+
+struct LogRecord
+{
+    spdlog::level::level_enum level{spdlog::level::off};
+    spdlog::log_clock::time_point time;
+    std::size_t thread_id{0};
+    // Points to literals, so it's still valid when written
+    spdlog::source_loc source;
+    std::size_t name_size{0};
+    std::size_t message_size{0};
+    std::array<char, LOGGER_NAME_SIZE> name;
+    std::array<char, LOG_MESSAGE_SIZE> message;
+};
+
+// Hands the messages, already formatted by the logger, over to a background
+// thread, which applies the pattern and writes them to the target sink.
+// Logging is just a copy into a lock-free ring, and a wake up if the writer
+// was idle.
+class AsyncSink final : public spdlog::sinks::sink
+{
+public:
+    explicit AsyncSink(std::shared_ptr<spdlog::sinks::sink> target)
+        : m_target{std::move(target)}, m_ring{LOG_RING_CAPACITY}
+    {
+        m_target->set_pattern(LOG_PATTERN);
+        m_thread = std::thread{&AsyncSink::Write, this};
+    }
+
+    ~AsyncSink() override
+    {
+        m_running = false;
+        m_wakeup.notify_one();
+        m_thread.join();
+    }
+
+    void log(const spdlog::details::log_msg& msg) override
+    {
+        LogRecord record;
+        record.level = msg.level;
+        record.time = msg.time;
+        record.thread_id = msg.thread_id;
+        record.source = msg.source;
+        record.name_size = std::min(msg.logger_name.size(), LOGGER_NAME_SIZE);
+        std::copy_n(msg.logger_name.data(), record.name_size,
+                    record.name.data());
+        record.message_size = std::min(msg.payload.size(), LOG_MESSAGE_SIZE);
+        std::copy_n(msg.payload.data(), record.message_size,
+                    record.message.data());
+        if (!m_ring.Push(record))
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        m_pushed.fetch_add(1, std::memory_order_release);
+        if (m_idle.load(std::memory_order_acquire))
+        {
+            m_wakeup.notify_one();
+        }
+    }
+
+    // Waits until the writer has written everything logged so far.
+    void flush() override
+    {
+        const uint64_t pushed{m_pushed.load(std::memory_order_acquire)};
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_wakeup.notify_one();
+        m_flushed.wait(lock, [this, pushed]
+                       {
+                           return m_written >= pushed;
+                       });
+        m_target->flush();
+    }
+
+    // The pattern of the library is fixed, and the writer thread is the
+    // only one using it.
+    void set_pattern(const std::string&) override
+    {
+    }
+
+    void set_formatter(std::unique_ptr<spdlog::formatter>) override
+    {
+    }
+
+private:
+    void Write()
+    {
+        LogRecord record;
+        while (true)
+        {
+            // Whatever is logged before stopping is written.
+            const bool running{m_running};
+            while (m_ring.Pop(record))
+            {
+                spdlog::details::log_msg msg{
+                    record.time,
+                    record.source,
+                    {record.name.data(), record.name_size},
+                    record.level,
+                    {record.message.data(), record.message_size}};
+                msg.thread_id = record.thread_id;
+                m_target->log(msg);
+                ++m_written;
+            }
+            const uint64_t dropped{
+                m_dropped.exchange(0, std::memory_order_relaxed)};
+            if (dropped > 0)
+            {
+                const std::string text{std::to_string(dropped) +
+                                       " log messages dropped"};
+                m_target->log(spdlog::details::log_msg{
+                    "ctello", spdlog::level::warn, text});
+            }
+            std::unique_lock<std::mutex> lock{m_mutex};
+            m_flushed.notify_all();
+            if (!running)
+            {
+                return;
+            }
+            m_idle.store(true, std::memory_order_release);
+            m_wakeup.wait_for(lock, LOG_IDLE_PERIOD);
+            m_idle.store(false, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    std::shared_ptr<spdlog::sinks::sink> m_target;
+    ctello::MpscRing<LogRecord> m_ring;
+    std::atomic<uint64_t> m_dropped{0};
+    std::atomic<uint64_t> m_pushed{0};
+    std::atomic<uint64_t> m_written{0};
+    std::atomic<bool> m_running{true};
+    std::atomic<bool> m_idle{false};
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::condition_variable m_flushed;
+    std::thread m_thread;
+};
+
+// Shared by all the loggers of the library
+std::shared_ptr<spdlog::sinks::sink> GetSink()
+{
+    static const auto sink = std::make_shared<AsyncSink>(
+        std::make_shared<spdlog::sinks::stdout_color_sink_mt>());
+    return sink;
+}
+
+std::atomic<spdlog::level::level_enum>& GetLevel()
+{
+    static std::atomic<spdlog::level::level_enum> level{
+        ctello::internal::GetLogLevelFromEnv("SPDLOG_LEVEL")};
+    return level;
+}
+}  // namespace
+
+namespace ctello
+{
+void SetLogLevel(const LogLevel level)
+{
+    // Same order as spdlog's levels
+    const auto spdlog_level = static_cast<spdlog::level::level_enum>(level);
+    GetLevel() = spdlog_level;
+    internal::GetLogger()->set_level(spdlog_level);
+}
+
+LogLevel GetLogLevel()
+{
+    return static_cast<LogLevel>(GetLevel().load());
+}
+
+void FlushLog()
+{
+    GetSink()->flush();
+}
+
+namespace internal
+{
+spdlog::logger* GetLogger()
+{
+    static const auto logger = CreateLogger("ctello");
+    return logger.get();
+}
+
+std::shared_ptr<spdlog::logger> CreateLogger(const std::string& name)
+{
+    auto logger = std::make_shared<spdlog::logger>(name, GetSink());
+    logger->set_level(GetLevel());
+    return logger;
+}
+}  // namespace internal
+}  // namespace ctello
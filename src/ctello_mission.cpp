@@ -0,0 +1,336 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#include "ctello_mission.h"
+
+#include <charconv>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <optional>
+#include <string_view>
+
+#include "ctello_internal.h"
+
+namespace
+{
+using ctello::FailurePolicy;
+using ResponseStatus = ctello::Response::Status;
+
+std::string_view Trim(std::string_view text)
+{
+    const auto first = text.find_first_not_of(" \t\r");
+    if (first == std::string_view::npos)
+    {
+        return {};
+    }
+    const auto last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+bool ParseInt(const std::string_view text, int& value)
+{
+    const auto result =
+        std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc{} && result.ptr == text.data() + text.size();
+}
+
+std::optional<FailurePolicy> ParsePolicy(const std::string_view text)
+{
+    if (text == "abort")
+    {
+        return FailurePolicy::ABORT;
+    }
+    if (text == "continue")
+    {
+        return FailurePolicy::CONTINUE;
+    }
+    if (text == "land")
+    {
+        return FailurePolicy::LAND;
+    }
+    return {};
+}
+
+// Applies an option ("key=value") to the step.
+bool ParseOption(const std::string_view option, ctello::MissionStep& step)
+{
+    const auto equal = option.find('=');
+    if (equal == std::string_view::npos)
+    {
+        return false;
+    }
+    const auto key = Trim(option.substr(0, equal));
+    const auto value = Trim(option.substr(equal + 1));
+    int number;
+    if (key == "timeout" && ParseInt(value, number))
+    {
+        step.timeout = std::chrono::milliseconds{number};
+        return true;
+    }
+    if (key == "retries" && ParseInt(value, number))
+    {
+        step.retries = number;
+        return true;
+    }
+    if (key == "on_failure")
+    {
+        const auto policy = ParsePolicy(value);
+        if (policy)
+        {
+            step.on_failure = *policy;
+        }
+        return policy.has_value();
+    }
+    return false;
+}
+
+const char* ToString(const ResponseStatus status)
+{
+    switch (status)
+    {
+    case ResponseStatus::OK:
+        return "ok";
+    case ResponseStatus::ERROR:
+        return "error";
+    case ResponseStatus::VALUE:
+        return "value";
+    case ResponseStatus::TIMEOUT:
+        return "timeout";
+    }
+    return "?";
+}
+
+std::chrono::microseconds Since(
+    const std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+}
+}  // namespace
+
+namespace ctello
+{
+MissionRunner::MissionRunner(Tello& tello) : m_tello{tello} {}
+
+MissionRunner::~MissionRunner()
+{
+    Stop();
+}
+
+void MissionRunner::Add(const std::string& command)
+{
+    MissionStep step;
+    step.command = command;
+    Add(step);
+}
+
+void MissionRunner::Add(const MissionStep& step)
+{
+    if (m_running)
+    {
+        CTELLO_ERROR("Can't add steps to a running mission");
+        return;
+    }
+    m_steps.push_back(step);
+}
+
+bool MissionRunner::LoadScript(const std::string& path)
+{
+    std::ifstream file{path};
+    if (!file)
+    {
+        CTELLO_ERROR("Couldn't open mission {}", path);
+        return false;
+    }
+    std::vector<MissionStep> steps;
+    std::string line;
+    int number{0};
+    while (std::getline(file, line))
+    {
+        ++number;
+        std::string_view text{line};
+        text = Trim(text.substr(0, text.find('#')));
+        if (text.empty())
+        {
+            continue;
+        }
+        MissionStep step;
+        const auto semicolon = text.find(';');
+        step.command = std::string{Trim(text.substr(0, semicolon))};
+        text.remove_prefix(std::min(semicolon, text.size()));
+        while (!text.empty())
+        {
+            // Skip the ';' and take the option up to the next one.
+            text.remove_prefix(1);
+            const auto end = text.find(';');
+            const auto option = Trim(text.substr(0, end));
+            if (!option.empty() && !ParseOption(option, step))
+            {
+                CTELLO_ERROR("{}:{}: Invalid option: {}", path, number, option);
+                return false;
+            }
+            text.remove_prefix(std::min(end, text.size()));
+        }
+        if (step.command.empty())
+        {
+            CTELLO_ERROR("{}:{}: Missing command", path, number);
+            return false;
+        }
+        steps.push_back(std::move(step));
+    }
+    for (const auto& step : steps)
+    {
+        Add(step);
+    }
+    return true;
+}
+
+bool MissionRunner::Start()
+{
+    if (m_running)
+    {
+        return false;
+    }
+    Wait();
+    // The dispatcher takes over the responses when it starts, which must
+    // happen on the caller's thread, not while it receives states.
+    if (!m_tello.StartCommandDispatcher())
+    {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock{m_results_mutex};
+        m_results.clear();
+    }
+    m_stop = false;
+    m_running = true;
+    m_thread = std::thread{&MissionRunner::Run, this};
+    return true;
+}
+
+void MissionRunner::Stop()
+{
+    m_stop = true;
+    Wait();
+}
+
+void MissionRunner::Wait()
+{
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+bool MissionRunner::IsRunning() const
+{
+    return m_running;
+}
+
+bool MissionRunner::Succeeded() const
+{
+    return m_succeeded;
+}
+
+std::vector<StepResult> MissionRunner::GetResults() const
+{
+    std::lock_guard<std::mutex> lock{m_results_mutex};
+    return m_results;
+}
+
+void MissionRunner::PrintReport(std::ostream& os) const
+{
+    const auto results = GetResults();
+    const auto ms = [](const std::chrono::microseconds us)
+    { return us.count() / 1000.0; };
+    os << std::left << std::setw(4) << "#" << std::setw(16) << "command"
+       << std::setw(10) << "status" << std::right << std::setw(9)
+       << "attempts" << std::setw(12) << "start ms" << std::setw(12)
+       << "took ms" << std::setw(12) << "latency ms" << std::endl;
+    os << std::fixed << std::setprecision(1);
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const StepResult& result{results[i]};
+        os << std::left << std::setw(4) << i << std::setw(16)
+           << result.command << std::setw(10)
+           << ToString(result.response.status) << std::right << std::setw(9)
+           << result.response.attempts << std::setw(12) << ms(result.start)
+           << std::setw(12) << ms(result.end - result.start) << std::setw(12)
+           << ms(result.response.latency) << std::endl;
+    }
+}
+
+void MissionRunner::Run()
+{
+    const auto start = std::chrono::steady_clock::now();
+    m_succeeded = true;
+    const auto run_step = [&](const MissionStep& step)
+    {
+        StepResult result;
+        result.command = step.command;
+        result.start = Since(start);
+        try
+        {
+            result.response =
+                m_tello
+                    .SendCommandAsync(step.command, step.timeout, step.retries)
+                    .get();
+        }
+        catch (const std::future_error&)
+        {
+            // The dispatcher was stopped, the response stays as a timeout.
+        }
+        result.end = Since(start);
+        CTELLO_INFO("Mission: {} -> {} ({} ms)", step.command,
+                    result.response.text.empty() ? "timeout"
+                                                 : result.response.text,
+                    (result.end - result.start).count() / 1000);
+        const bool failed{result.response.status == ResponseStatus::ERROR ||
+                          result.response.status == ResponseStatus::TIMEOUT};
+        std::lock_guard<std::mutex> lock{m_results_mutex};
+        m_results.push_back(std::move(result));
+        return !failed;
+    };
+
+    for (const MissionStep& step : m_steps)
+    {
+        if (m_stop)
+        {
+            m_succeeded = false;
+            break;
+        }
+        if (run_step(step))
+        {
+            continue;
+        }
+        m_succeeded = false;
+        if (step.on_failure == FailurePolicy::CONTINUE)
+        {
+            continue;
+        }
+        if (step.on_failure == FailurePolicy::LAND)
+        {
+            CTELLO_WARN("Mission: {} failed, landing", step.command);
+            run_step({"land"});
+        }
+        break;
+    }
+    m_running = false;
+}
+}  // namespace ctello
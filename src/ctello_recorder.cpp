@@ -0,0 +1,443 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#include "ctello_recorder.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "ctello_internal.h"
+#include "spdlog/spdlog.h"
+
+namespace
+{
+using ctello::STATE_FIELDS;
+using ctello::STATE_VALUE_COUNT;
+using ctello::TELEMETRY_BLOCK_CAPACITY;
+
+const char MAGIC[8]{'C', 'T', 'E', 'L', 'L', 'O', 'T', 'M'};
+const uint32_t VERSION{1};
+
+// On-disk layout, see ctello_recorder.h
+struct ColumnHeader
+{
+    char name[8];
+    // StateFieldType
+    uint32_t type;
+    // Index within the field ("mpry" has 3)
+    uint32_t index;
+};
+
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t column_count;
+    uint32_t block_capacity;
+    uint32_t block_size;
+    uint64_t block_count;
+    // System clock nanoseconds when the recording started
+    int64_t start_time;
+    ColumnHeader columns[STATE_VALUE_COUNT];
+};
+
+struct BlockHeader
+{
+    uint64_t size;
+    int64_t first_timestamp;
+    int64_t last_timestamp;
+};
+
+const std::size_t HEADER_SIZE{4096};
+const std::size_t BLOCK_HEADER_SIZE{64};
+const std::size_t TIMESTAMPS_OFFSET{BLOCK_HEADER_SIZE};
+const std::size_t VALUES_OFFSET{TIMESTAMPS_OFFSET +
+                                TELEMETRY_BLOCK_CAPACITY * sizeof(int64_t)};
+const std::size_t VALUE_SIZE{4};
+const std::size_t BLOCK_SIZE{VALUES_OFFSET + STATE_VALUE_COUNT *
+                                                 TELEMETRY_BLOCK_CAPACITY *
+                                                 VALUE_SIZE};
+
+static_assert(sizeof(FileHeader) <= HEADER_SIZE);
+static_assert(sizeof(BlockHeader) <= BLOCK_HEADER_SIZE);
+// Blocks stay aligned for their timestamps.
+static_assert(BLOCK_SIZE % sizeof(int64_t) == 0);
+
+// Blocks added to the file each time it runs out of space
+const std::size_t GROW_BLOCKS{4};
+
+std::size_t FileSize(const std::size_t blocks)
+{
+    return HEADER_SIZE + blocks * BLOCK_SIZE;
+}
+
+// Values are stored in TelloState order, which has no padding, so the
+// column of a value is its offset in TelloState divided by its size.
+std::size_t Column(const ctello::StateField& field, const int index)
+{
+    return field.offset / VALUE_SIZE + index;
+}
+
+std::size_t ValueOffset(const std::size_t column, const std::size_t slot)
+{
+    return VALUES_OFFSET + (column * TELEMETRY_BLOCK_CAPACITY + slot) *
+                               VALUE_SIZE;
+}
+}  // namespace
+
+namespace ctello
+{
+TelemetryRecorder::~TelemetryRecorder()
+{
+    Close();
+}
+
+bool TelemetryRecorder::Open(const std::string& path)
+{
+    Close();
+    m_fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_fd == -1)
+    {
+        CTELLO_ERROR("open {}: {} ({})", path, errno, strerror(errno));
+        return false;
+    }
+    m_mapped_size = FileSize(0);
+    void* data{MAP_FAILED};
+    if (ftruncate(m_fd, m_mapped_size) == -1 ||
+        (data = mmap(nullptr, m_mapped_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, m_fd, 0)) == MAP_FAILED)
+    {
+        CTELLO_ERROR("mmap {}: {} ({})", path, errno, strerror(errno));
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    m_data = static_cast<char*>(data);
+    m_size = 0;
+
+    FileHeader& header{*reinterpret_cast<FileHeader*>(m_data)};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.column_count = STATE_VALUE_COUNT;
+    header.block_capacity = TELEMETRY_BLOCK_CAPACITY;
+    header.block_size = BLOCK_SIZE;
+    header.block_count = 0;
+    header.start_time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::system_clock::now().time_since_epoch())
+                            .count();
+    for (const auto& field : STATE_FIELDS)
+    {
+        for (int i = 0; i < field.count; ++i)
+        {
+            ColumnHeader& column{header.columns[Column(field, i)]};
+            const std::size_t length{
+                std::min(field.name.size(), sizeof(column.name))};
+            std::memcpy(column.name, field.name.data(), length);
+            column.type = static_cast<uint32_t>(field.type);
+            column.index = i;
+        }
+    }
+    CTELLO_INFO("Recording telemetry to {}", path);
+    return true;
+}
+
+void TelemetryRecorder::Close()
+{
+    if (m_data == nullptr)
+    {
+        return;
+    }
+    const std::size_t blocks{
+        reinterpret_cast<const FileHeader*>(m_data)->block_count};
+    munmap(m_data, m_mapped_size);
+    m_data = nullptr;
+    // Drop the blocks which were allocated but never used.
+    if (ftruncate(m_fd, FileSize(blocks)) == -1)
+    {
+        CTELLO_ERROR("ftruncate: {} ({})", errno, strerror(errno));
+    }
+    close(m_fd);
+    m_fd = -1;
+    m_mapped_size = 0;
+}
+
+bool TelemetryRecorder::IsOpen() const
+{
+    return m_data != nullptr;
+}
+
+bool TelemetryRecorder::Append(const TelloState& state)
+{
+    return Append(state, std::chrono::steady_clock::now().time_since_epoch());
+}
+
+bool TelemetryRecorder::Append(const TelloState& state,
+                               const std::chrono::nanoseconds timestamp)
+{
+    if (m_data == nullptr)
+    {
+        return false;
+    }
+    const std::size_t block{m_size / TELEMETRY_BLOCK_CAPACITY};
+    const std::size_t slot{m_size % TELEMETRY_BLOCK_CAPACITY};
+    if (FileSize(block + 1) > m_mapped_size && !Grow())
+    {
+        return false;
+    }
+    char* const data{m_data + FileSize(block)};
+    BlockHeader& block_header{*reinterpret_cast<BlockHeader*>(data)};
+    if (slot == 0)
+    {
+        block_header.first_timestamp = timestamp.count();
+        reinterpret_cast<FileHeader*>(m_data)->block_count = block + 1;
+    }
+
+    reinterpret_cast<int64_t*>(data + TIMESTAMPS_OFFSET)[slot] =
+        timestamp.count();
+    const char* const values{reinterpret_cast<const char*>(&state)};
+    for (std::size_t column = 0; column < STATE_VALUE_COUNT; ++column)
+    {
+        std::memcpy(data + ValueOffset(column, slot),
+                    values + column * VALUE_SIZE, VALUE_SIZE);
+    }
+    block_header.last_timestamp = timestamp.count();
+    block_header.size = slot + 1;
+    ++m_size;
+    return true;
+}
+
+std::size_t TelemetryRecorder::Size() const
+{
+    return m_size;
+}
+
+bool TelemetryRecorder::Grow()
+{
+    const std::size_t size{m_mapped_size + GROW_BLOCKS * BLOCK_SIZE};
+    if (ftruncate(m_fd, size) == -1)
+    {
+        CTELLO_ERROR("ftruncate: {} ({})", errno, strerror(errno));
+        return false;
+    }
+    void* const data{mremap(m_data, m_mapped_size, size, MREMAP_MAYMOVE)};
+    if (data == MAP_FAILED)
+    {
+        CTELLO_ERROR("mremap: {} ({})", errno, strerror(errno));
+        return false;
+    }
+    m_data = static_cast<char*>(data);
+    m_mapped_size = size;
+    return true;
+}
+
+TelemetryReader::~TelemetryReader()
+{
+    Close();
+}
+
+bool TelemetryReader::Open(const std::string& path)
+{
+    Close();
+    const int fd{open(path.c_str(), O_RDONLY)};
+    if (fd == -1)
+    {
+        CTELLO_ERROR("open {}: {} ({})", path, errno, strerror(errno));
+        return false;
+    }
+    struct stat info
+    {
+    };
+    if (fstat(fd, &info) == -1 ||
+        static_cast<std::size_t>(info.st_size) < HEADER_SIZE)
+    {
+        CTELLO_ERROR("{} is not a telemetry file", path);
+        close(fd);
+        return false;
+    }
+    m_mapped_size = info.st_size;
+    void* const data{
+        mmap(nullptr, m_mapped_size, PROT_READ, MAP_SHARED, fd, 0)};
+    // The mapping keeps the file open.
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        CTELLO_ERROR("mmap {}: {} ({})", path, errno, strerror(errno));
+        return false;
+    }
+    m_data = static_cast<const char*>(data);
+
+    const FileHeader& header{*reinterpret_cast<const FileHeader*>(m_data)};
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.version != VERSION ||
+        header.column_count != STATE_VALUE_COUNT ||
+        header.block_capacity != TELEMETRY_BLOCK_CAPACITY ||
+        header.block_size != BLOCK_SIZE)
+    {
+        CTELLO_ERROR("{} is not a version {} telemetry file", path, VERSION);
+        Close();
+        return false;
+    }
+
+    // Blocks the header counts but the file doesn't have were lost.
+    m_block_count = std::min<std::size_t>(
+        header.block_count, (m_mapped_size - HEADER_SIZE) / BLOCK_SIZE);
+    m_size = 0;
+    if (m_block_count > 0)
+    {
+        const auto& last =
+            *reinterpret_cast<const BlockHeader*>(Block(m_block_count - 1));
+        m_size = (m_block_count - 1) * TELEMETRY_BLOCK_CAPACITY +
+                 std::min<std::size_t>(last.size, TELEMETRY_BLOCK_CAPACITY);
+    }
+    return true;
+}
+
+void TelemetryReader::Close()
+{
+    if (m_data == nullptr)
+    {
+        return;
+    }
+    munmap(const_cast<char*>(m_data), m_mapped_size);
+    m_data = nullptr;
+    m_mapped_size = 0;
+    m_block_count = 0;
+    m_size = 0;
+}
+
+bool TelemetryReader::IsOpen() const
+{
+    return m_data != nullptr;
+}
+
+std::size_t TelemetryReader::Size() const
+{
+    return m_size;
+}
+
+std::chrono::nanoseconds TelemetryReader::GetTimestamp(
+    const std::size_t sample) const
+{
+    if (sample >= m_size)
+    {
+        return {};
+    }
+    const char* const data{Block(sample / TELEMETRY_BLOCK_CAPACITY)};
+    const std::size_t slot{sample % TELEMETRY_BLOCK_CAPACITY};
+    return std::chrono::nanoseconds{
+        reinterpret_cast<const int64_t*>(data + TIMESTAMPS_OFFSET)[slot]};
+}
+
+bool TelemetryReader::Read(const std::size_t sample, TelloState& state) const
+{
+    if (sample >= m_size)
+    {
+        return false;
+    }
+    const char* const data{Block(sample / TELEMETRY_BLOCK_CAPACITY)};
+    const std::size_t slot{sample % TELEMETRY_BLOCK_CAPACITY};
+    char* const values{reinterpret_cast<char*>(&state)};
+    for (std::size_t column = 0; column < STATE_VALUE_COUNT; ++column)
+    {
+        std::memcpy(values + column * VALUE_SIZE,
+                    data + ValueOffset(column, slot), VALUE_SIZE);
+    }
+    return true;
+}
+
+double TelemetryReader::GetValue(const std::size_t sample,
+                                 const StateField& field,
+                                 const int index) const
+{
+    if (sample >= m_size)
+    {
+        return 0;
+    }
+    const char* const data{Block(sample / TELEMETRY_BLOCK_CAPACITY)};
+    const char* const value{data + ValueOffset(Column(field, index),
+                                               sample %
+                                                   TELEMETRY_BLOCK_CAPACITY)};
+    if (field.type == StateFieldType::INT)
+    {
+        int32_t number;
+        std::memcpy(&number, value, sizeof(number));
+        return number;
+    }
+    float number;
+    std::memcpy(&number, value, sizeof(number));
+    return number;
+}
+
+std::size_t TelemetryReader::Find(const std::chrono::nanoseconds timestamp) const
+{
+    // First block which ends at or after the timestamp
+    std::size_t first{0};
+    std::size_t last{m_block_count};
+    while (first < last)
+    {
+        const std::size_t middle{first + (last - first) / 2};
+        const auto& header =
+            *reinterpret_cast<const BlockHeader*>(Block(middle));
+        if (header.last_timestamp < timestamp.count())
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+    if (first == m_block_count)
+    {
+        return m_size;
+    }
+
+    const char* const data{Block(first)};
+    const int64_t* const timestamps{
+        reinterpret_cast<const int64_t*>(data + TIMESTAMPS_OFFSET)};
+    const std::size_t size{
+        std::min(m_size - first * TELEMETRY_BLOCK_CAPACITY,
+                 TELEMETRY_BLOCK_CAPACITY)};
+    const auto found =
+        std::lower_bound(timestamps, timestamps + size, timestamp.count());
+    return first * TELEMETRY_BLOCK_CAPACITY + (found - timestamps);
+}
+
+std::chrono::system_clock::time_point TelemetryReader::GetStartTime() const
+{
+    if (m_data == nullptr)
+    {
+        return {};
+    }
+    const FileHeader& header{*reinterpret_cast<const FileHeader*>(m_data)};
+    return std::chrono::system_clock::time_point{
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::nanoseconds{header.start_time})};
+}
+
+const char* TelemetryReader::Block(const std::size_t block) const
+{
+    return m_data + FileSize(block);
+}
+}  // namespace ctello
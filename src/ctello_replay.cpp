@@ -0,0 +1,120 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#include "ctello_replay.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "ctello_internal.h"
+
+namespace ctello
+{
+bool TelemetryReplay::Open(const std::string& path, const double speed)
+{
+    if (!m_reader.Open(path))
+    {
+        return false;
+    }
+    m_speed = std::max(speed, REPLAY_AS_FAST_AS_POSSIBLE);
+    CTELLO_INFO("Replaying {} states from {} at {}", m_reader.Size(), path,
+                m_speed > 0 ? std::to_string(m_speed) + "x"
+                            : std::string{"full speed"});
+    Rewind();
+    return true;
+}
+
+void TelemetryReplay::Rewind()
+{
+    m_next = 0;
+    m_start = std::chrono::steady_clock::now();
+    m_first_timestamp = m_reader.Size() > 0 ? m_reader.GetTimestamp(0)
+                                            : std::chrono::nanoseconds{0};
+    m_last_timestamp = m_first_timestamp;
+}
+
+bool TelemetryReplay::Next(TelloState& state)
+{
+    if (IsFinished() ||
+        (m_speed > 0 && std::chrono::steady_clock::now() < DueTime(m_next)))
+    {
+        return false;
+    }
+    m_reader.Read(m_next, state);
+    m_last_timestamp = m_reader.GetTimestamp(m_next);
+    ++m_next;
+    return true;
+}
+
+bool TelemetryReplay::WaitForNext(TelloState& state,
+                                  const std::chrono::milliseconds timeout)
+{
+    if (IsFinished())
+    {
+        return false;
+    }
+    if (m_speed > 0)
+    {
+        auto wake_up = DueTime(m_next);
+        if (timeout.count() >= 0)
+        {
+            wake_up = std::min(wake_up,
+                               std::chrono::steady_clock::now() + timeout);
+        }
+        std::this_thread::sleep_until(wake_up);
+    }
+    return Next(state);
+}
+
+bool TelemetryReplay::IsFinished() const
+{
+    return m_next >= m_reader.Size();
+}
+
+std::chrono::nanoseconds TelemetryReplay::Now() const
+{
+    if (m_speed > 0)
+    {
+        const std::chrono::duration<double, std::nano> elapsed{
+            std::chrono::steady_clock::now() - m_start};
+        return std::chrono::nanoseconds{
+            static_cast<int64_t>(elapsed.count() * m_speed)};
+    }
+    return m_last_timestamp - m_first_timestamp;
+}
+
+std::size_t TelemetryReplay::Position() const
+{
+    return m_next;
+}
+
+std::size_t TelemetryReplay::Size() const
+{
+    return m_reader.Size();
+}
+
+std::chrono::steady_clock::time_point TelemetryReplay::DueTime(
+    const std::size_t sample) const
+{
+    const std::chrono::duration<double, std::nano> offset{
+        (m_reader.GetTimestamp(sample) - m_first_timestamp).count() /
+        m_speed};
+    return m_start +
+           std::chrono::duration_cast<std::chrono::nanoseconds>(offset);
+}
+}  // namespace ctello
@@ -0,0 +1,144 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#include <getopt.h>
+#include <signal.h>
+
+#include <cstdlib>
+#include <iostream>
+
+#include "ctello_simulator.h"
+
+using ctello::Simulator;
+using ctello::SimulatorOptions;
+
+// clang-format off
+const char* const USAGE =
+"Usage: ctello-sim [OPTIONS]\n"
+"\n"
+"Simulates a Tello drone (SDK 2.0) on a local UDP port.\n"
+"\n"
+"  -i, --ip IP            IP to listen on                   [127.0.0.1]\n"
+"  -p, --port PORT        Command port                      [8889]\n"
+"  -s, --state-port PORT  Client port to send states to     [8890]\n"
+"  -r, --state-rate HZ    States per second, 0 to disable   [10]\n"
+"  -l, --latency MS       Delay of every datagram sent      [0]\n"
+"  -j, --jitter MS        Random +/- variation of the delay [0]\n"
+"  -d, --loss P           Probability of dropping [0-1]     [0]\n"
+"  -o, --reorder P        Probability of reordering [0-1]   [0]\n"
+"  -e, --seed N           Seed of the random generator      [0]\n"
+"  -h, --help             Show this help\n";
+// clang-format on
+
+namespace
+{
+Simulator* g_simulator{nullptr};
+
+void Stop(int)
+{
+    g_simulator->Stop();
+}
+
+std::chrono::microseconds ToMicroseconds(const char* const ms)
+{
+    return std::chrono::microseconds{
+        static_cast<int64_t>(std::atof(ms) * 1000)};
+}
+}  // namespace
+
+int main(const int argc, char* const args[])
+{
+    // clang-format off
+    const option long_options[] = {
+        {"ip",         required_argument, nullptr, 'i'},
+        {"port",       required_argument, nullptr, 'p'},
+        {"state-port", required_argument, nullptr, 's'},
+        {"state-rate", required_argument, nullptr, 'r'},
+        {"latency",    required_argument, nullptr, 'l'},
+        {"jitter",     required_argument, nullptr, 'j'},
+        {"loss",       required_argument, nullptr, 'd'},
+        {"reorder",    required_argument, nullptr, 'o'},
+        {"seed",       required_argument, nullptr, 'e'},
+        {"help",       no_argument,       nullptr, 'h'},
+        {nullptr,      0,                 nullptr, 0}
+    };
+    // clang-format on
+
+    SimulatorOptions options;
+    int opt;
+    while ((opt = getopt_long(argc, args, "i:p:s:r:l:j:d:o:e:h", long_options,
+                              nullptr)) != -1)
+    {
+        switch (opt)
+        {
+        case 'i':
+            options.ip = optarg;
+            break;
+        case 'p':
+            options.command_port = std::atoi(optarg);
+            break;
+        case 's':
+            options.state_port = std::atoi(optarg);
+            break;
+        case 'r':
+            options.state_rate = std::atof(optarg);
+            break;
+        case 'l':
+            options.latency = ToMicroseconds(optarg);
+            break;
+        case 'j':
+            options.jitter = ToMicroseconds(optarg);
+            break;
+        case 'd':
+            options.loss = std::atof(optarg);
+            break;
+        case 'o':
+            options.reorder = std::atof(optarg);
+            break;
+        case 'e':
+            options.seed = std::atoi(optarg);
+            break;
+        case 'h':
+            std::cout << USAGE;
+            return 0;
+        default:
+            std::cerr << USAGE;
+            return 1;
+        }
+    }
+
+    Simulator simulator{options};
+    if (!simulator.Bind())
+    {
+        return 1;
+    }
+    g_simulator = &simulator;
+    signal(SIGINT, Stop);
+    signal(SIGTERM, Stop);
+
+    simulator.Run();
+
+    const auto stats = simulator.GetStats();
+    std::cout << std::endl;
+    std::cout << "Commands:  " << stats.commands << std::endl;
+    std::cout << "Responses: " << stats.responses << std::endl;
+    std::cout << "States:    " << stats.states << std::endl;
+    std::cout << "Dropped:   " << stats.dropped << std::endl;
+    std::cout << "Reordered: " << stats.reordered << std::endl;
+    return 0;
+}
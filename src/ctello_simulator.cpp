@@ -0,0 +1,442 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#include "ctello_simulator.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <sstream>
+
+#include "ctello_internal.h"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+// Serial number reported by "sn?"
+const char* const SIMULATOR_SERIAL_NUMBER{"0TQSIMULATOR"};
+
+// Height after taking off (cm)
+const int TAKEOFF_HEIGHT{80};
+
+// Splits a command into its words.
+std::vector<std::string> Split(const std::string& command)
+{
+    std::vector<std::string> words;
+    std::stringstream ss{command};
+    std::string word;
+    while (ss >> word)
+    {
+        words.push_back(word);
+    }
+    return words;
+}
+
+// Whether all the arguments (words after the first one) are integers in
+// [min, max].
+bool ArgsInRange(const std::vector<std::string>& words,
+                 const std::size_t count,
+                 const int min,
+                 const int max)
+{
+    if (words.size() != count + 1)
+    {
+        return false;
+    }
+    for (std::size_t i = 1; i < words.size(); ++i)
+    {
+        char* end{nullptr};
+        const long value = std::strtol(words[i].c_str(), &end, 10);
+        if (*end != '\0' || value < min || value > max)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Wraps an angle to [-180, 180).
+int WrapAngle(const int degrees)
+{
+    return ((degrees + 180) % 360 + 360) % 360 - 180;
+}
+}  // namespace
+
+namespace ctello
+{
+Simulator::Simulator(const SimulatorOptions& options)
+    : m_options{options}, m_random{options.seed}
+{
+    m_sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    m_stop_fd = eventfd(0, EFD_NONBLOCK);
+    m_state.bat = 100;
+    m_state.templ = 60;
+    m_state.temph = 63;
+    m_state.tof = 10;
+    m_state.agz = -1000;
+    m_power_on_time = Clock::now();
+}
+
+Simulator::~Simulator()
+{
+    close(m_sockfd);
+    close(m_stop_fd);
+}
+
+bool Simulator::Bind()
+{
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(m_options.command_port);
+    if (inet_pton(AF_INET, m_options.ip.c_str(), &addr.sin_addr) != 1)
+    {
+        CTELLO_ERROR("Invalid IP: {}", m_options.ip);
+        return false;
+    }
+    if (bind(m_sockfd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) ==
+        -1)
+    {
+        CTELLO_ERROR("bind to {}:{}: {} ({})", m_options.ip,
+                     m_options.command_port, errno, strerror(errno));
+        return false;
+    }
+    CTELLO_INFO("Simulated Tello listening on {}:{}", m_options.ip,
+                m_options.command_port);
+    return true;
+}
+
+void Simulator::Run()
+{
+    const auto state_period =
+        m_options.state_rate > 0
+            ? std::chrono::duration_cast<Clock::duration>(
+                  std::chrono::duration<double>{1.0 / m_options.state_rate})
+            : Clock::duration::max();
+    auto next_state = Clock::now();
+
+    std::array<pollfd, 2> fds{{{m_sockfd, POLLIN, 0}, {m_stop_fd, POLLIN, 0}}};
+    std::array<char, 1024> buffer;
+    while (true)
+    {
+        auto now = Clock::now();
+        if (m_sdk_mode && m_options.state_rate > 0)
+        {
+            // If we fell far behind, don't try to catch up.
+            if (now - next_state > 100 * state_period)
+            {
+                next_state = now;
+            }
+            while (next_state <= now)
+            {
+                UpdateState(now);
+                Enqueue(ctello::FormatState(m_state), m_client_addr);
+                ++m_stats.states;
+                next_state += state_period;
+            }
+        }
+        SendDue(now);
+
+        // Sleep until the next thing to send, or until a command arrives.
+        auto wake_up = m_sdk_mode ? next_state : Clock::time_point::max();
+        if (!m_outgoing.empty())
+        {
+            wake_up = std::min(wake_up, m_outgoing.top().due);
+        }
+        timespec timeout{};
+        timespec* timeout_ptr{nullptr};
+        if (wake_up != Clock::time_point::max())
+        {
+            const auto left = std::max(wake_up - now, Clock::duration{0});
+            const auto ns =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(left);
+            timeout.tv_sec = ns.count() / 1000000000;
+            timeout.tv_nsec = ns.count() % 1000000000;
+            timeout_ptr = &timeout;
+        }
+        if (ppoll(fds.data(), fds.size(), timeout_ptr, nullptr) == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            CTELLO_ERROR("ppoll: {} ({})", errno, strerror(errno));
+            return;
+        }
+        if (fds[1].revents)
+        {
+            return;
+        }
+        if (!fds[0].revents)
+        {
+            continue;
+        }
+
+        sockaddr_in sender{};
+        socklen_t sender_len{sizeof(sender)};
+        int bytes;
+        while ((bytes = recvfrom(m_sockfd, buffer.data(), buffer.size(),
+                                 MSG_DONTWAIT,
+                                 reinterpret_cast<sockaddr*>(&sender),
+                                 &sender_len)) > 0)
+        {
+            ++m_stats.commands;
+            std::string command{buffer.data(),
+                                static_cast<std::size_t>(bytes)};
+            command.erase(command.find_last_not_of(" \n\r\t") + 1);
+            CTELLO_DEBUG("<<<< {}", command);
+
+            m_client_addr = sender;
+            m_client_addr.sin_port = htons(m_options.state_port);
+            UpdateState(Clock::now());
+            if (auto response = HandleCommand(command))
+            {
+                CTELLO_DEBUG(">>>> {}", *response);
+                Enqueue(std::move(*response), sender);
+                ++m_stats.responses;
+            }
+        }
+    }
+}
+
+void Simulator::Stop()
+{
+    const uint64_t one{1};
+    // Nothing sensible to do if it fails within a signal handler.
+    [[maybe_unused]] const auto result = write(m_stop_fd, &one, sizeof(one));
+}
+
+SimulatorStats Simulator::GetStats() const
+{
+    return m_stats;
+}
+
+std::optional<std::string> Simulator::HandleCommand(const std::string& command)
+{
+    const auto words = ::Split(command);
+    if (words.empty())
+    {
+        return "error";
+    }
+    const std::string& verb{words[0]};
+    const auto arg = [&words](const std::size_t i) {
+        return std::stoi(words[i]);
+    };
+
+    if (verb == "command")
+    {
+        m_sdk_mode = true;
+        return "ok";
+    }
+
+    // Read commands
+    if (verb == "speed?")
+    {
+        return std::to_string(m_speed);
+    }
+    if (verb == "battery?")
+    {
+        return std::to_string(m_state.bat);
+    }
+    if (verb == "time?")
+    {
+        return std::to_string(m_state.time) + "s";
+    }
+    if (verb == "wifi?")
+    {
+        return "90";
+    }
+    if (verb == "sdk?")
+    {
+        return "20";
+    }
+    if (verb == "sn?")
+    {
+        return SIMULATOR_SERIAL_NUMBER;
+    }
+
+    // Control commands
+    if (words.size() == 1 &&
+        (verb == "streamon" || verb == "streamoff" || verb == "stop" ||
+         verb == "mon" || verb == "moff"))
+    {
+        return "ok";
+    }
+    if (verb == "takeoff")
+    {
+        if (m_flying)
+        {
+            return "error";
+        }
+        m_flying = true;
+        m_takeoff_time = Clock::now();
+        m_state.h = TAKEOFF_HEIGHT;
+        m_state.tof = TAKEOFF_HEIGHT + 10;
+        return "ok";
+    }
+    if (verb == "land" || verb == "emergency")
+    {
+        m_flying = false;
+        m_state.h = 0;
+        m_state.tof = 10;
+        return "ok";
+    }
+    if (verb == "rc")
+    {
+        // Tello doesn't answer rc commands.
+        if (::ArgsInRange(words, 4, -100, 100) && m_flying)
+        {
+            m_state.vgx = arg(2) / 10;
+            m_state.vgy = arg(1) / 10;
+            m_state.vgz = -arg(3) / 10;
+        }
+        return {};
+    }
+    if (!m_flying)
+    {
+        // Everything else needs the motors on, or it's just invalid.
+        const bool settable = verb == "speed" || verb == "wifi" ||
+                              verb == "ap" || verb == "mdirection";
+        if (!settable)
+        {
+            return "error";
+        }
+    }
+    if ((verb == "up" || verb == "down") && ::ArgsInRange(words, 1, 20, 500))
+    {
+        m_state.h = std::max(0, m_state.h + (verb == "up" ? 1 : -1) * arg(1));
+        m_state.tof = m_state.h + 10;
+        return "ok";
+    }
+    if ((verb == "left" || verb == "right" || verb == "forward" ||
+         verb == "back") &&
+        ::ArgsInRange(words, 1, 20, 500))
+    {
+        return "ok";
+    }
+    if ((verb == "cw" || verb == "ccw") && ::ArgsInRange(words, 1, 1, 360))
+    {
+        m_state.yaw =
+            ::WrapAngle(m_state.yaw + (verb == "cw" ? 1 : -1) * arg(1));
+        return "ok";
+    }
+    if (verb == "flip" && words.size() == 2 &&
+        (words[1] == "l" || words[1] == "r" || words[1] == "f" ||
+         words[1] == "b"))
+    {
+        return "ok";
+    }
+    if (verb == "go" && ::ArgsInRange(words, 4, -500, 500) &&
+        arg(4) >= 10 && arg(4) <= 100)
+    {
+        m_state.h = std::max(0, m_state.h + arg(3));
+        return "ok";
+    }
+    if (verb == "curve" && ::ArgsInRange(words, 7, -500, 500) &&
+        arg(7) >= 10 && arg(7) <= 60)
+    {
+        return "ok";
+    }
+    if (verb == "speed" && ::ArgsInRange(words, 1, 10, 100))
+    {
+        m_speed = arg(1);
+        return "ok";
+    }
+    if (verb == "mdirection" && ::ArgsInRange(words, 1, 0, 2))
+    {
+        return "ok";
+    }
+    if ((verb == "wifi" || verb == "ap") && words.size() == 3)
+    {
+        return "ok";
+    }
+    return "error";
+}
+
+void Simulator::UpdateState(const Clock::time_point now)
+{
+    using std::chrono::duration_cast;
+    using std::chrono::seconds;
+
+    if (m_flying)
+    {
+        m_state.time =
+            static_cast<int>(duration_cast<seconds>(now - m_takeoff_time)
+                                 .count());
+    }
+    else
+    {
+        m_state.vgx = m_state.vgy = m_state.vgz = 0;
+    }
+    // 1% per minute since powering on, plus 1% per 30 seconds of flight.
+    const auto on_time = duration_cast<seconds>(now - m_power_on_time).count();
+    m_state.bat = std::max(0, 100 - static_cast<int>(on_time / 60) -
+                                  m_state.time / 30);
+    m_state.baro = m_state.h / 100.0f;
+}
+
+void Simulator::Enqueue(std::string payload, const sockaddr_in& dest)
+{
+    std::uniform_real_distribution<double> probability{0.0, 1.0};
+    if (m_options.loss > 0 && probability(m_random) < m_options.loss)
+    {
+        ++m_stats.dropped;
+        return;
+    }
+
+    auto delay = m_options.latency;
+    if (m_options.jitter.count() > 0)
+    {
+        std::uniform_int_distribution<int64_t> jitter{
+            -m_options.jitter.count(), m_options.jitter.count()};
+        delay += std::chrono::microseconds{jitter(m_random)};
+    }
+    if (m_options.reorder > 0 && probability(m_random) < m_options.reorder)
+    {
+        // Enough for the next datagrams to overtake this one.
+        delay += std::max(std::chrono::microseconds{5000},
+                          2 * (m_options.latency + m_options.jitter));
+        ++m_stats.reordered;
+    }
+    delay = std::max(delay, std::chrono::microseconds{0});
+    m_outgoing.push(
+        {Clock::now() + delay, m_order++, std::move(payload), dest});
+}
+
+void Simulator::SendDue(const Clock::time_point now)
+{
+    while (!m_outgoing.empty() && m_outgoing.top().due <= now)
+    {
+        const Datagram& datagram{m_outgoing.top()};
+        if (sendto(m_sockfd, datagram.payload.data(), datagram.payload.size(),
+                   0, reinterpret_cast<const sockaddr*>(&datagram.dest),
+                   sizeof(datagram.dest)) == -1)
+        {
+            CTELLO_WARN("sendto: {} ({})", errno, strerror(errno));
+        }
+        m_outgoing.pop();
+    }
+}
+}  // namespace ctello
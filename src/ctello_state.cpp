@@ -16,50 +16,451 @@
 //
 //  You can contact the author via carlospzlz@gmail.com
 
+#include <getopt.h>
+#include <signal.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
 #include <cstdlib>
-#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
 
 #include "ctello.h"
+#include "ctello_recorder.h"
+#include "ctello_replay.h"
 
+using ctello::StateField;
+using ctello::StateFieldType;
+using ctello::STATE_FIELDS;
+using ctello::TelemetryRecorder;
 using ctello::Tello;
+using ctello::TelloState;
+
+// clang-format off
+const char* const USAGE =
+"Usage: ctello-state [OPTIONS]\n"
+"\n"
+"Shows the state of Tello.\n"
+"\n"
+"  -r, --record FILE   Also record every state into a telemetry file\n"
+"  -p, --replay FILE   Show the states of a telemetry file instead\n"
+"  -s, --speed X       Replay speed, 0 for as fast as possible   [1]\n"
+"  -i, --interval MS   Time between updates of the screen      [100]\n"
+"  -t, --stats         Also show the rate of change, minimum and\n"
+"                      maximum of every field\n"
+"  -h, --help          Show this help\n";
+// clang-format on
+
+// Checked often enough to stop promptly.
+const std::chrono::milliseconds STATE_TIMEOUT{100};
+
+std::atomic<bool> g_running{true};
+
+void Stop(int)
+{
+    g_running = false;
+}
 
-void ShowStatus(const std::string& state)
+// Columns of the table and how wide they are, with and without the stats
+const std::array<const char*, 5> COLUMN_NAMES{"field", "value", "rate/s",
+                                              "min", "max"};
+const std::size_t NAME_WIDTH{11};
+const std::size_t VALUE_WIDTH{11};
+const std::size_t STATS_WIDTH{15};
+
+// Values of a field as Tello sends them, comma separated when it has several.
+// Rates have a decimal even for integer fields.
+std::string FormatValues(const StateField& field,
+                         const double* const values,
+                         const bool is_rate)
 {
-    system("clear");
-    int begin{0};
-    std::cout << "+-----------+-----------+" << std::endl;
-    const int padding{10};
-    while (begin < state.size())
-    {
-        const auto split{state.find(':', begin)};
-        const auto name{state.substr(begin, split - begin)};
-        const auto end{state.find(';', split)};
-        const auto value{state.substr(split + 1, end - split - 1)};
-        begin = end + 1;
-
-        std::cout << "|  " << name;
-        std::cout << std::setw(padding - name.size()) << "|";
-        std::cout << "  " << value;
-        std::cout << std::setw(padding - value.size()) << "|";
-        std::cout << std::endl;
-    }
-    std::cout << "+-----------+-----------+" << std::endl;
+    std::string text;
+    std::array<char, 32> buffer;
+    for (int i = 0; i < field.count; ++i)
+    {
+        if (i > 0)
+        {
+            text += ',';
+        }
+        if (is_rate)
+        {
+            std::snprintf(buffer.data(), buffer.size(), "%.1f", values[i]);
+        }
+        else if (field.type == StateFieldType::INT)
+        {
+            std::snprintf(buffer.data(), buffer.size(), "%d",
+                          static_cast<int>(values[i]));
+        }
+        else
+        {
+            std::snprintf(buffer.data(), buffer.size(), "%.2f", values[i]);
+        }
+        text += buffer.data();
+    }
+    return text;
 }
 
-int main()
+// Draws the table once and then, on every update, only moves the cursor to
+// the cells which changed and rewrites them, so the terminal doesn't flicker
+// and hardly anything is written. Every state is taken, so the minimums and
+// maximums don't miss any, but the screen is only updated when Render() is
+// called.
+class StateScreen
+{
+public:
+    explicit StateScreen(const bool show_stats)
+        : m_widths{NAME_WIDTH, show_stats ? STATS_WIDTH : VALUE_WIDTH},
+          m_first_row{show_stats ? 3u : 1u}
+    {
+        if (show_stats)
+        {
+            m_widths.insert(m_widths.end(), 3, STATS_WIDTH);
+        }
+        m_cells.resize(STATE_FIELDS.size() * m_widths.size());
+        m_min.fill(std::numeric_limits<double>::max());
+        m_max.fill(std::numeric_limits<double>::lowest());
+        DrawTable();
+    }
+
+    ~StateScreen()
+    {
+        // Leave the cursor below the table, and show it again.
+        MoveTo(GetStatusRow() + 1, 1);
+        m_output += "\x1b[?25h";
+        Flush();
+    }
+
+    void Update(const TelloState& state, const std::chrono::nanoseconds time)
+    {
+        std::size_t index{0};
+        for (const auto& field : STATE_FIELDS)
+        {
+            for (int i = 0; i < field.count; ++i, ++index)
+            {
+                const double value{ctello::GetStateValue(state, field, i)};
+                m_values[index] = value;
+                m_min[index] = std::min(m_min[index], value);
+                m_max[index] = std::max(m_max[index], value);
+            }
+        }
+        m_time = time;
+        ++m_states;
+    }
+
+    void Render(const std::chrono::steady_clock::time_point now)
+    {
+        if (m_states > 0)
+        {
+            RenderValues();
+        }
+
+        // How many states arrived since the last time
+        std::array<char, 64> status;
+        if (m_rendered_at != std::chrono::steady_clock::time_point{})
+        {
+            const std::chrono::duration<double> elapsed{now - m_rendered_at};
+            std::snprintf(status.data(), status.size(), "%.1f states/s",
+                          (m_states - m_rendered_states) / elapsed.count());
+            DrawText(GetStatusRow(), 3, m_status,
+                     status.data());
+        }
+        m_rendered_at = now;
+        m_rendered_states = m_states;
+        Flush();
+    }
+
+private:
+    void RenderValues()
+    {
+        // Rates are averaged since the last update of the screen, which
+        // smooths them out, and in the time of the states, so they're right
+        // when replaying at another speed too.
+        const bool has_rates{m_has_rendered_values &&
+                             m_time > m_rendered_values_time};
+        if (has_rates)
+        {
+            const std::chrono::duration<double> elapsed{
+                m_time - m_rendered_values_time};
+            for (std::size_t i = 0; i < m_values.size(); ++i)
+            {
+                m_rates[i] =
+                    (m_values[i] - m_rendered_values[i]) / elapsed.count();
+            }
+        }
+        if (!m_has_rendered_values || m_time > m_rendered_values_time)
+        {
+            m_rendered_values = m_values;
+            m_rendered_values_time = m_time;
+            m_has_rendered_values = true;
+        }
+
+        std::size_t index{0};
+        for (std::size_t row = 0; row < STATE_FIELDS.size(); ++row)
+        {
+            const StateField& field{STATE_FIELDS[row]};
+            DrawCell(row, 1, FormatValues(field, &m_values[index], false));
+            if (m_widths.size() > 2)
+            {
+                if (has_rates)
+                {
+                    DrawCell(row, 2,
+                             FormatValues(field, &m_rates[index], true));
+                }
+                DrawCell(row, 3, FormatValues(field, &m_min[index], false));
+                DrawCell(row, 4, FormatValues(field, &m_max[index], false));
+            }
+            index += field.count;
+        }
+    }
+
+    // Draws the borders, the header and the names of the fields, which never
+    // change, below whatever is on the terminal.
+    void DrawTable()
+    {
+        // Anything logged later than this would end up in the table.
+        ctello::FlushLog();
+
+        std::string border{"+"};
+        for (const std::size_t width : m_widths)
+        {
+            border += std::string(width, '-') + "+";
+        }
+        border += "\n";
+
+        // Hide the cursor, so it doesn't jump around the cells.
+        m_output += "\x1b[?25l";
+        m_output += border;
+        if (m_widths.size() > 2)
+        {
+            m_output += FormatRow(COLUMN_NAMES.data()) + border;
+        }
+        for (const auto& field : STATE_FIELDS)
+        {
+            const std::string name{field.name};
+            const char* const cells[]{name.c_str(), "", "", "", ""};
+            m_output += FormatRow(cells);
+        }
+        m_output += border;
+        // Room for the status line
+        m_output += "\n";
+        m_cursor_row = GetStatusRow() + 1;
+        Flush();
+    }
+
+    std::size_t GetStatusRow() const
+    {
+        return m_first_row + STATE_FIELDS.size() + 1;
+    }
+
+    std::string FormatRow(const char* const* const cells) const
+    {
+        std::string row{"|"};
+        for (std::size_t column = 0; column < m_widths.size(); ++column)
+        {
+            row += Fit(cells[column], m_widths[column]) + "|";
+        }
+        return row + "\n";
+    }
+
+    void DrawCell(const std::size_t row,
+                  const std::size_t column,
+                  const std::string& text)
+    {
+        std::size_t x{1};
+        for (std::size_t i = 0; i < column; ++i)
+        {
+            x += m_widths[i] + 1;
+        }
+        DrawText(m_first_row + row, x + 1,
+                 m_cells[row * m_widths.size() + column],
+                 Fit(text, m_widths[column]));
+    }
+
+    // Writes the text, unless it's already there.
+    void DrawText(const std::size_t row,
+                  const std::size_t x,
+                  std::string& drawn,
+                  const std::string& text)
+    {
+        if (text == drawn)
+        {
+            return;
+        }
+        MoveTo(row, x);
+        m_output += text;
+        // Whatever was longer is cleared.
+        if (drawn.size() > text.size())
+        {
+            m_output.append(drawn.size() - text.size(), ' ');
+        }
+        drawn = text;
+    }
+
+    // Padded with spaces, or cut, to exactly the width of the cell
+    static std::string Fit(const std::string& text, const std::size_t width)
+    {
+        std::string cell{"  " + text};
+        cell.resize(width, ' ');
+        return cell;
+    }
+
+    // Rows count from the top border. The cursor is moved relative to where
+    // it is, so the table doesn't need to be at the top of the terminal.
+    void MoveTo(const std::size_t row, const std::size_t x)
+    {
+        if (row < m_cursor_row)
+        {
+            m_output += "\x1b[" + std::to_string(m_cursor_row - row) + "A";
+        }
+        else if (row > m_cursor_row)
+        {
+            m_output += "\x1b[" + std::to_string(row - m_cursor_row) + "B";
+        }
+        m_output += "\x1b[" + std::to_string(x) + "G";
+        m_cursor_row = row;
+    }
+
+    // Everything drawn goes out in a single write.
+    void Flush()
+    {
+        if (m_output.empty())
+        {
+            return;
+        }
+        std::cout << m_output << std::flush;
+        m_output.clear();
+    }
+
+private:
+    std::vector<std::size_t> m_widths;
+    // Row of the first field and of the cursor
+    std::size_t m_first_row;
+    std::size_t m_cursor_row{0};
+    // What each cell shows now, by row and column
+    std::vector<std::string> m_cells;
+    std::string m_status;
+    std::string m_output;
+
+    // Latest values, and their extremes, counting each of "mpry" separately
+    std::array<double, ctello::STATE_VALUE_COUNT> m_values{};
+    std::array<double, ctello::STATE_VALUE_COUNT> m_min;
+    std::array<double, ctello::STATE_VALUE_COUNT> m_max;
+    std::array<double, ctello::STATE_VALUE_COUNT> m_rates{};
+    std::chrono::nanoseconds m_time{0};
+    uint64_t m_states{0};
+
+    // As they were when the screen was last updated
+    std::array<double, ctello::STATE_VALUE_COUNT> m_rendered_values{};
+    std::chrono::nanoseconds m_rendered_values_time{0};
+    bool m_has_rendered_values{false};
+    uint64_t m_rendered_states{0};
+    std::chrono::steady_clock::time_point m_rendered_at;
+};
+
+int main(const int argc, char* const args[])
 {
+    // clang-format off
+    const option long_options[] = {
+        {"record",   required_argument, nullptr, 'r'},
+        {"replay",   required_argument, nullptr, 'p'},
+        {"speed",    required_argument, nullptr, 's'},
+        {"interval", required_argument, nullptr, 'i'},
+        {"stats",    no_argument,       nullptr, 't'},
+        {"help",     no_argument,       nullptr, 'h'},
+        {nullptr,    0,                 nullptr, 0}
+    };
+    // clang-format on
+
+    std::string record_path;
+    std::string replay_path;
+    double speed{1};
+    std::chrono::milliseconds interval{100};
+    bool show_stats{false};
+    int opt;
+    while ((opt = getopt_long(argc, args, "r:p:s:i:th", long_options,
+                              nullptr)) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            record_path = optarg;
+            break;
+        case 'p':
+            replay_path = optarg;
+            break;
+        case 's':
+            speed = std::atof(optarg);
+            break;
+        case 'i':
+            interval = std::chrono::milliseconds{std::atoi(optarg)};
+            break;
+        case 't':
+            show_stats = true;
+            break;
+        case 'h':
+            std::cout << USAGE;
+            return 0;
+        default:
+            std::cerr << USAGE;
+            return 1;
+        }
+    }
+    if (interval.count() <= 0)
+    {
+        std::cerr << "Invalid interval: " << interval.count() << std::endl;
+        return 1;
+    }
+
     Tello tello{};
-    if (!tello.Bind())
+    if (replay_path.empty() ? !tello.Bind()
+                            : !tello.OpenReplay(replay_path, speed))
     {
         return 0;
     }
 
-    while (true)
+    // Stop cleanly, so the recording is trimmed to what was recorded.
+    TelemetryRecorder recorder;
+    if (!record_path.empty() && !recorder.Open(record_path))
     {
-        if (const auto state = tello.GetState())
+        return 1;
+    }
+    signal(SIGINT, Stop);
+    signal(SIGTERM, Stop);
+
+    TelloState state;
+    const ctello::TelemetryReplay* const replay{tello.GetReplay()};
+    // States arrive at their own pace, while the screen is updated at a
+    // steady one, which doesn't depend on them.
+    StateScreen screen{show_stats};
+    auto next_render = std::chrono::steady_clock::now();
+    while (g_running && !(replay && replay->IsFinished()))
+    {
+        const auto time_left =
+            std::chrono::ceil<std::chrono::milliseconds>(
+                next_render - std::chrono::steady_clock::now());
+        if (tello.WaitForState(state, std::clamp(time_left,
+                                                 std::chrono::milliseconds{0},
+                                                 STATE_TIMEOUT)))
+        {
+            recorder.Append(state);
+            // Recorded time when replaying, so rates are right at any speed
+            screen.Update(state,
+                          replay ? replay->Now()
+                                 : std::chrono::steady_clock::now()
+                                       .time_since_epoch());
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= next_render)
         {
-            ShowStatus(*state);
+            screen.Render(now);
+            next_render = now + interval;
         }
     }
+    // Whatever arrived since the last update
+    screen.Render(std::chrono::steady_clock::now());
+    return 0;
 }
@@ -0,0 +1,307 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#include "ctello_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+namespace
+{
+using ctello::LatencyHistogram;
+
+// Verbs of the Tello SDK 2.0, followed by the one of everything else
+const std::array<std::string_view, 33> VERBS{
+    "command", "takeoff",  "land",     "streamon", "streamoff", "emergency",
+    "up",      "down",     "left",     "right",    "forward",   "back",
+    "cw",      "ccw",      "flip",     "go",       "stop",      "curve",
+    "jump",    "speed",    "rc",       "wifi",     "mon",       "moff",
+    "ap",      "speed?",   "battery?", "time?",    "wifi?",     "sdk?",
+    "sn?",     "mdirection",           "other"};
+
+// Tello doesn't answer this one.
+const std::string_view RC_VERB{"rc"};
+
+const uint64_t MAX_LATENCY_US{
+    (uint64_t{1} << (LatencyHistogram::MAX_EXPONENT + 1)) - 1};
+
+std::chrono::microseconds ToMicroseconds(
+    const std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration);
+}
+}  // namespace
+
+namespace ctello
+{
+void LatencyHistogram::Record(const std::chrono::microseconds latency)
+{
+    const uint64_t us{static_cast<uint64_t>(
+        std::clamp<int64_t>(latency.count(), 0, MAX_LATENCY_US))};
+    m_buckets[GetBucket(us)].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(us, std::memory_order_relaxed);
+}
+
+LatencySummary LatencyHistogram::Summarize() const
+{
+    std::array<uint64_t, BUCKET_COUNT> counts;
+    LatencySummary summary;
+    for (int i = 0; i < BUCKET_COUNT; ++i)
+    {
+        counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+        summary.count += counts[i];
+    }
+    if (summary.count == 0)
+    {
+        return summary;
+    }
+    using std::chrono::microseconds;
+    summary.mean =
+        microseconds(m_sum.load(std::memory_order_relaxed) / summary.count);
+
+    // Smallest latency with at least this many below or equal
+    const auto rank = [&summary](const double percentile)
+    {
+        return std::max<uint64_t>(
+            1, static_cast<uint64_t>(std::ceil(percentile * summary.count)));
+    };
+    const std::array<std::pair<uint64_t, microseconds*>, 4> ranks{
+        {{rank(0.5), &summary.p50},
+         {rank(0.9), &summary.p90},
+         {rank(0.99), &summary.p99},
+         {summary.count, &summary.max}}};
+    std::size_t next{0};
+    uint64_t seen{0};
+    for (int i = 0; i < BUCKET_COUNT && next < ranks.size(); ++i)
+    {
+        if (counts[i] == 0)
+        {
+            continue;
+        }
+        if (seen == 0)
+        {
+            summary.min = microseconds(GetBucketMax(i));
+        }
+        seen += counts[i];
+        while (next < ranks.size() && seen >= ranks[next].first)
+        {
+            *ranks[next].second = microseconds(GetBucketMax(i));
+            ++next;
+        }
+    }
+    return summary;
+}
+
+int LatencyHistogram::GetBucket(const uint64_t us)
+{
+    // Below two sub-bucket ranges, every microsecond has its own bucket.
+    if (us < 2 * SUB_BUCKETS)
+    {
+        return static_cast<int>(us);
+    }
+    const int exponent{63 - __builtin_clzll(us)};
+    const int shift{exponent - SUB_BUCKET_BITS};
+    // From SUB_BUCKETS to 2 * SUB_BUCKETS - 1
+    const int sub_bucket{static_cast<int>(us >> shift)};
+    return shift * SUB_BUCKETS + sub_bucket;
+}
+
+uint64_t LatencyHistogram::GetBucketMax(const int bucket)
+{
+    if (bucket < 2 * SUB_BUCKETS)
+    {
+        return bucket;
+    }
+    const int shift{bucket / SUB_BUCKETS - 1};
+    const uint64_t sub_bucket{
+        static_cast<uint64_t>(bucket % SUB_BUCKETS + SUB_BUCKETS)};
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+void PrintStats(std::ostream& os, const TelloStats& stats)
+{
+    const auto ms = [](const std::chrono::microseconds us)
+    { return us.count() / 1000.0; };
+    os << std::left << std::setw(12) << "command" << std::right
+       << std::setw(7) << "sent" << std::setw(7) << "ok" << std::setw(7)
+       << "error" << std::setw(7) << "value" << std::setw(9) << "timeout"
+       << std::setw(10) << "p50 ms" << std::setw(10) << "p90 ms"
+       << std::setw(10) << "p99 ms" << std::setw(10) << "max ms"
+       << std::endl;
+    os << std::fixed << std::setprecision(1);
+    for (const CommandStats& command : stats.commands)
+    {
+        os << std::left << std::setw(12) << command.verb << std::right
+           << std::setw(7) << command.sent << std::setw(7) << command.ok
+           << std::setw(7) << command.errors << std::setw(7)
+           << command.values << std::setw(9) << command.timeouts
+           << std::setw(10) << ms(command.latency.p50) << std::setw(10)
+           << ms(command.latency.p90) << std::setw(10)
+           << ms(command.latency.p99) << std::setw(10)
+           << ms(command.latency.max) << std::endl;
+    }
+    os << "Unexpected responses: " << stats.unexpected_responses
+       << std::endl;
+
+    const StateStats& states{stats.states};
+    os << "States: " << states.received << " received, " << states.malformed
+       << " malformed, " << states.gaps << " gaps" << std::endl;
+    os << "State interval (ms): p50 " << ms(states.interval.p50) << ", p99 "
+       << ms(states.interval.p99) << ", max " << ms(states.interval.max)
+       << ", jitter " << ms(states.jitter) << std::endl;
+}
+
+StatsCollector::StatsCollector(const Clock::duration timeout)
+    : m_timeout{timeout}
+{
+}
+
+void StatsCollector::OnCommandSent(const std::string_view command,
+                                   const Clock::time_point time)
+{
+    // The previous command is known to be unanswered only after the timeout.
+    int previous{m_waiting.load(std::memory_order_acquire)};
+    const Clock::time_point previous_sent_at{
+        Clock::duration{m_sent_at.load(std::memory_order_relaxed)}};
+    if (previous != -1 && time - previous_sent_at >= m_timeout &&
+        m_waiting.compare_exchange_strong(previous, -1,
+                                          std::memory_order_relaxed))
+    {
+        m_verbs[previous].timeouts.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const std::size_t verb{FindVerb(command)};
+    m_verbs[verb].sent.fetch_add(1, std::memory_order_relaxed);
+    if (VERBS[verb] == RC_VERB)
+    {
+        return;
+    }
+    m_sent_at.store(time.time_since_epoch().count(),
+                    std::memory_order_relaxed);
+    m_waiting.store(static_cast<int>(verb), std::memory_order_release);
+}
+
+void StatsCollector::OnResponse(const std::string_view response,
+                                const Clock::time_point time)
+{
+    const int verb{m_waiting.exchange(-1, std::memory_order_acquire)};
+    if (verb == -1)
+    {
+        m_unexpected_responses.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    VerbCounters& counters{m_verbs[verb]};
+    if (response == "ok")
+    {
+        counters.ok.fetch_add(1, std::memory_order_relaxed);
+    }
+    else if (response.rfind("error", 0) == 0)
+    {
+        counters.errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        counters.values.fetch_add(1, std::memory_order_relaxed);
+    }
+    const Clock::time_point sent_at{
+        Clock::duration(m_sent_at.load(std::memory_order_relaxed))};
+    counters.latency.Record(ToMicroseconds(time - sent_at));
+}
+
+void StatsCollector::OnTimeout()
+{
+    const int verb{m_waiting.exchange(-1, std::memory_order_relaxed)};
+    if (verb != -1)
+    {
+        m_verbs[verb].timeouts.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void StatsCollector::OnState(const Clock::time_point time)
+{
+    if (m_states.fetch_add(1, std::memory_order_relaxed) > 0)
+    {
+        const Clock::duration interval{time - m_last_state};
+        m_state_intervals.Record(ToMicroseconds(interval));
+        if (interval > STATE_GAP)
+        {
+            m_state_gaps.fetch_add(1, std::memory_order_relaxed);
+        }
+        else if (m_last_interval.count() != 0)
+        {
+            // J += (|D| - J) / 16, skipping gaps which aren't jitter
+            const double difference{std::abs(
+                std::chrono::duration<double, std::micro>(interval -
+                                                          m_last_interval)
+                    .count())};
+            const double jitter{m_jitter_us.load(std::memory_order_relaxed)};
+            m_jitter_us.store(jitter + (difference - jitter) / 16,
+                              std::memory_order_relaxed);
+        }
+        m_last_interval = interval > STATE_GAP ? Clock::duration{0} : interval;
+    }
+    m_last_state = time;
+}
+
+void StatsCollector::OnMalformedState()
+{
+    m_malformed_states.fetch_add(1, std::memory_order_relaxed);
+}
+
+TelloStats StatsCollector::GetStats() const
+{
+    TelloStats stats;
+    for (std::size_t i = 0; i < VERB_COUNT; ++i)
+    {
+        const VerbCounters& counters{m_verbs[i]};
+        const uint64_t sent{counters.sent.load(std::memory_order_relaxed)};
+        if (sent == 0)
+        {
+            continue;
+        }
+        CommandStats command;
+        command.verb = VERBS[i];
+        command.sent = sent;
+        command.ok = counters.ok.load(std::memory_order_relaxed);
+        command.errors = counters.errors.load(std::memory_order_relaxed);
+        command.values = counters.values.load(std::memory_order_relaxed);
+        command.timeouts = counters.timeouts.load(std::memory_order_relaxed);
+        command.latency = counters.latency.Summarize();
+        stats.commands.push_back(std::move(command));
+    }
+    stats.unexpected_responses =
+        m_unexpected_responses.load(std::memory_order_relaxed);
+
+    stats.states.received = m_states.load(std::memory_order_relaxed);
+    stats.states.malformed = m_malformed_states.load(std::memory_order_relaxed);
+    stats.states.gaps = m_state_gaps.load(std::memory_order_relaxed);
+    stats.states.interval = m_state_intervals.Summarize();
+    stats.states.jitter = std::chrono::microseconds(static_cast<int64_t>(
+        m_jitter_us.load(std::memory_order_relaxed)));
+    return stats;
+}
+
+std::size_t StatsCollector::FindVerb(const std::string_view command)
+{
+    static_assert(VERBS.size() == VERB_COUNT);
+    const std::string_view verb{command.substr(0, command.find(' '))};
+    const auto last = VERBS.end() - 1;
+    return std::find(VERBS.begin(), last, verb) - VERBS.begin();
+}
+}  // namespace ctello
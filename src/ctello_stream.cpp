@@ -40,8 +40,7 @@ int main()
     }
 
     tello.SendCommand("streamon");
-    while (!(tello.ReceiveResponse()))
-        ;
+    tello.WaitForResponse();
 
     VideoCapture capture{TELLO_STREAM_URL, CAP_FFMPEG};
     while (true)
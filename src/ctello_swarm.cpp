@@ -0,0 +1,382 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#include "ctello_swarm.h"
+
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <string>
+
+#include "ctello_internal.h"
+#include "spdlog/spdlog.h"
+
+namespace
+{
+// Time to wait for the drones to answer before we send "command" again.
+const std::chrono::milliseconds FIND_SWARM_TIMEOUT{1000};
+
+// Maximum events handled per epoll_wait.
+const int MAX_EVENTS{2};
+
+// Datagrams received per syscall, and their maximum sizes
+const std::size_t RECEIVE_BATCH_SIZE{32};
+const std::size_t RESPONSE_SIZE{64};
+const std::size_t STATE_SIZE{1024};
+
+const sockaddr_in& AsInet(const sockaddr_storage& addr)
+{
+    return reinterpret_cast<const sockaddr_in&>(addr);
+}
+
+// Key of an IPv4 address and port, in network byte order.
+uint64_t AddrKey(const sockaddr_storage& addr)
+{
+    const sockaddr_in& in{AsInet(addr)};
+    return (static_cast<uint64_t>(in.sin_addr.s_addr) << 16) | in.sin_port;
+}
+}  // namespace
+
+namespace ctello
+{
+Swarm::Swarm(const int local_server_state_port)
+    : m_local_server_state_port{local_server_state_port},
+      m_response_batch{RECEIVE_BATCH_SIZE, RESPONSE_SIZE},
+      m_state_batch{RECEIVE_BATCH_SIZE, STATE_SIZE}
+{
+    m_command_sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    m_state_sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    m_epoll_fd = epoll_create1(0);
+    for (const int sockfd : {m_command_sockfd, m_state_sockfd})
+    {
+        const auto result = internal::AddToEpoll(m_epoll_fd, sockfd);
+        if (!result.first)
+        {
+            CTELLO_ERROR(result.second);
+        }
+    }
+}
+
+Swarm::~Swarm()
+{
+    close(m_epoll_fd);
+    close(m_command_sockfd);
+    close(m_state_sockfd);
+}
+
+int Swarm::Add(const std::string& ip, const std::string& command_port)
+{
+    m_drones.push_back({});
+    m_drones.back().ip = ip;
+    m_drones.back().command_port = command_port;
+    return static_cast<int>(m_drones.size()) - 1;
+}
+
+bool Swarm::Bind(const int local_client_command_port,
+                 const std::chrono::milliseconds timeout)
+{
+    // UDP Client to send commands and receive responses
+    auto result =
+        internal::BindSocketToPort(m_command_sockfd, local_client_command_port);
+    if (!result.first)
+    {
+        CTELLO_ERROR(result.second);
+        return false;
+    }
+
+    // Local UDP Server to listen for the states of all the drones
+    result = internal::BindSocketToPort(m_state_sockfd,
+                                        m_local_server_state_port);
+    if (!result.first)
+    {
+        CTELLO_ERROR(result.second);
+        return false;
+    }
+
+    for (std::size_t i = 0; i < m_drones.size(); ++i)
+    {
+        Drone& drone{m_drones[i]};
+        result = internal::FindSocketAddr(
+            drone.ip.c_str(), drone.command_port.c_str(), &drone.addr);
+        if (!result.first)
+        {
+            CTELLO_ERROR(result.second);
+            return false;
+        }
+        m_drones_by_addr[::AddrKey(drone.addr)] = i;
+        m_drones_by_ip.emplace(::AsInet(drone.addr).sin_addr.s_addr, i);
+    }
+    m_command_batch = DatagramBatch{m_drones.size(), 0};
+
+    // Finding the swarm
+    CTELLO_INFO("Finding {} Tellos ...", m_drones.size());
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    std::vector<bool> found(m_drones.size(), false);
+    std::size_t found_count{0};
+    while (found_count < m_drones.size())
+    {
+        for (std::size_t i = 0; i < m_drones.size(); ++i)
+        {
+            if (!found[i])
+            {
+                SendCommand(i, "command");
+            }
+        }
+        auto retry = std::chrono::steady_clock::now() + FIND_SWARM_TIMEOUT;
+        if (timeout.count() >= 0)
+        {
+            retry = std::min(retry, deadline);
+        }
+        while (found_count < m_drones.size())
+        {
+            const auto time_left =
+                internal::TimeLeft(FIND_SWARM_TIMEOUT, retry);
+            if (time_left.count() == 0)
+            {
+                break;
+            }
+            Poll(time_left);
+            for (std::size_t i = 0; i < m_drones.size(); ++i)
+            {
+                if (!found[i] && ReceiveResponse(i))
+                {
+                    found[i] = true;
+                    ++found_count;
+                    CTELLO_INFO("Tello {} ({}) entered SDK mode", i,
+                                m_drones[i].ip);
+                }
+            }
+        }
+        if (internal::TimeLeft(timeout, deadline).count() == 0)
+        {
+            break;
+        }
+    }
+
+    if (found_count < m_drones.size())
+    {
+        for (std::size_t i = 0; i < m_drones.size(); ++i)
+        {
+            if (!found[i])
+            {
+                CTELLO_ERROR("Tello {} ({}) not found", i, m_drones[i].ip);
+            }
+        }
+        return false;
+    }
+
+    // Drones which were sent "command" more than once may have answered
+    // every time, and the extra "ok" would be taken as the response to the
+    // next command.
+    ReceiveResponses();
+    for (Drone& drone : m_drones)
+    {
+        drone.responses.clear();
+    }
+    return true;
+}
+
+std::size_t Swarm::Size() const
+{
+    return m_drones.size();
+}
+
+bool Swarm::SendCommand(const int drone, const std::string& command)
+{
+    Drone& target{m_drones.at(drone)};
+    const int bytes =
+        sendto(m_command_sockfd, command.data(), command.size(), 0,
+               reinterpret_cast<const sockaddr*>(&target.addr),
+               sizeof(sockaddr_in));
+    if (bytes == -1)
+    {
+        CTELLO_ERROR("sendto {}: {} ({})", target.ip, errno, strerror(errno));
+        return false;
+    }
+    CTELLO_DEBUG(">>>> {} bytes >>>> {}:{}: {}", bytes, target.ip,
+                 target.command_port, command);
+    return true;
+}
+
+int Swarm::Broadcast(const std::string& command)
+{
+    m_command_batch.Clear();
+    for (const Drone& drone : m_drones)
+    {
+        m_command_batch.Add(drone.addr, command);
+    }
+    const int sent{m_command_batch.Send(m_command_sockfd)};
+    CTELLO_DEBUG(">>>> {} datagrams >>>> swarm: {}", sent, command);
+    return std::max(sent, 0);
+}
+
+int Swarm::Poll(const std::chrono::milliseconds timeout)
+{
+    // Don't wait if there is something already.
+    int received{ReceiveResponses() + ReceiveStates()};
+    if (received > 0 || timeout.count() == 0)
+    {
+        return received;
+    }
+
+    std::array<epoll_event, MAX_EVENTS> events;
+    const int count = epoll_wait(m_epoll_fd, events.data(), events.size(),
+                                 static_cast<int>(timeout.count()));
+    if (count == -1)
+    {
+        if (errno != EINTR)
+        {
+            CTELLO_ERROR("epoll_wait: {} ({})", errno, strerror(errno));
+        }
+        return 0;
+    }
+    return count > 0 ? ReceiveResponses() + ReceiveStates() : 0;
+}
+
+std::optional<std::string> Swarm::ReceiveResponse(const int drone)
+{
+    auto& responses = m_drones.at(drone).responses;
+    if (responses.empty())
+    {
+        return {};
+    }
+    std::string response{std::move(responses.front())};
+    responses.pop_front();
+    return response;
+}
+
+bool Swarm::GetState(const int drone, TelloState& state)
+{
+    Drone& source{m_drones.at(drone)};
+    if (!source.new_state)
+    {
+        return false;
+    }
+    state = source.state;
+    source.new_state = false;
+    return true;
+}
+
+std::vector<std::optional<std::string>> Swarm::WaitForResponses(
+    const std::chrono::milliseconds timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    std::vector<std::optional<std::string>> responses(m_drones.size());
+    std::size_t pending{m_drones.size()};
+    while (true)
+    {
+        for (std::size_t i = 0; i < m_drones.size(); ++i)
+        {
+            if (!responses[i] && (responses[i] = ReceiveResponse(i)))
+            {
+                --pending;
+            }
+        }
+        const auto time_left = internal::TimeLeft(timeout, deadline);
+        if (pending == 0 || time_left.count() == 0)
+        {
+            return responses;
+        }
+        Poll(time_left);
+    }
+}
+
+int Swarm::GetPollFd() const
+{
+    return m_epoll_fd;
+}
+
+int Swarm::FindDrone(const sockaddr_storage& addr) const
+{
+    const auto by_addr = m_drones_by_addr.find(::AddrKey(addr));
+    if (by_addr != m_drones_by_addr.end())
+    {
+        return by_addr->second;
+    }
+    const auto by_ip = m_drones_by_ip.find(::AsInet(addr).sin_addr.s_addr);
+    if (by_ip != m_drones_by_ip.end())
+    {
+        return by_ip->second;
+    }
+    return -1;
+}
+
+int Swarm::ReceiveResponses()
+{
+    int received{0};
+    int count;
+    while ((count = m_response_batch.Receive(m_command_sockfd)) > 0)
+    {
+        received += count;
+        for (int i = 0; i < count; ++i)
+        {
+            const int drone{FindDrone(m_response_batch.Address(i))};
+            std::string response{m_response_batch.Payload(i)};
+            // Some responses contain trailing white spaces.
+            response.erase(response.find_last_not_of(" \n\r\t") + 1);
+            if (drone == -1)
+            {
+                CTELLO_WARN("Response from unknown drone: {}", response);
+                continue;
+            }
+            CTELLO_DEBUG("<<<< {} bytes <<<< {}:{}: {}",
+                         m_response_batch.Payload(i).size(), m_drones[drone].ip,
+                         m_drones[drone].command_port, response);
+            m_drones[drone].responses.push_back(std::move(response));
+        }
+        // A partial batch means the socket is empty.
+        if (count < static_cast<int>(m_response_batch.Capacity()))
+        {
+            break;
+        }
+    }
+    return received;
+}
+
+int Swarm::ReceiveStates()
+{
+    int received{0};
+    int count;
+    while ((count = m_state_batch.Receive(m_state_sockfd)) > 0)
+    {
+        received += count;
+        for (int i = 0; i < count; ++i)
+        {
+            const int drone{FindDrone(m_state_batch.Address(i))};
+            if (drone == -1)
+            {
+                continue;
+            }
+            Drone& source{m_drones[drone]};
+            if (ParseState(m_state_batch.Payload(i), source.state))
+            {
+                source.new_state = true;
+            }
+        }
+        if (count < static_cast<int>(m_state_batch.Capacity()))
+        {
+            break;
+        }
+    }
+    return received;
+}
+}  // namespace ctello
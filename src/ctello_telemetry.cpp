@@ -0,0 +1,200 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#include "ctello_telemetry.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace ctello
+{
+// clang-format off
+const std::array<StateField, STATE_FIELD_COUNT> STATE_FIELDS{{
+    {"mid",   StateFieldType::INT,   offsetof(TelloState, mid),   1},
+    {"x",     StateFieldType::INT,   offsetof(TelloState, x),     1},
+    {"y",     StateFieldType::INT,   offsetof(TelloState, y),     1},
+    {"z",     StateFieldType::INT,   offsetof(TelloState, z),     1},
+    {"mpry",  StateFieldType::INT,   offsetof(TelloState, mpry),  3},
+    {"pitch", StateFieldType::INT,   offsetof(TelloState, pitch), 1},
+    {"roll",  StateFieldType::INT,   offsetof(TelloState, roll),  1},
+    {"yaw",   StateFieldType::INT,   offsetof(TelloState, yaw),   1},
+    {"vgx",   StateFieldType::INT,   offsetof(TelloState, vgx),   1},
+    {"vgy",   StateFieldType::INT,   offsetof(TelloState, vgy),   1},
+    {"vgz",   StateFieldType::INT,   offsetof(TelloState, vgz),   1},
+    {"templ", StateFieldType::INT,   offsetof(TelloState, templ), 1},
+    {"temph", StateFieldType::INT,   offsetof(TelloState, temph), 1},
+    {"tof",   StateFieldType::INT,   offsetof(TelloState, tof),   1},
+    {"h",     StateFieldType::INT,   offsetof(TelloState, h),     1},
+    {"bat",   StateFieldType::INT,   offsetof(TelloState, bat),   1},
+    {"baro",  StateFieldType::FLOAT, offsetof(TelloState, baro),  1},
+    {"time",  StateFieldType::INT,   offsetof(TelloState, time),  1},
+    {"agx",   StateFieldType::FLOAT, offsetof(TelloState, agx),   1},
+    {"agy",   StateFieldType::FLOAT, offsetof(TelloState, agy),   1},
+    {"agz",   StateFieldType::FLOAT, offsetof(TelloState, agz),   1},
+}};
+// clang-format on
+
+// Values are parsed straight into place, so they all have to be 4 bytes.
+static_assert(sizeof(int) == 4 && sizeof(float) == 4);
+static_assert(sizeof(TelloState) == STATE_VALUE_COUNT * 4);
+
+namespace
+{
+// Finds the field with the given name. Fields usually come in order, so
+// the search starts right after the previously found one.
+const StateField* FindField(const std::string_view name, std::size_t& hint)
+{
+    for (std::size_t i = 0; i < STATE_FIELD_COUNT; ++i)
+    {
+        const std::size_t index{(hint + i) % STATE_FIELD_COUNT};
+        if (STATE_FIELDS[index].name == name)
+        {
+            hint = index + 1;
+            return &STATE_FIELDS[index];
+        }
+    }
+    return nullptr;
+}
+
+// Parses a number of type T from the beginning of [first, last) into dest.
+// Returns the position after the number, or nullptr if malformed.
+template <typename T>
+const char* ParseValue(const char* first, const char* last, char* dest)
+{
+    T value{};
+    const auto result = std::from_chars(first, last, value);
+    if (result.ec != std::errc{})
+    {
+        return nullptr;
+    }
+    std::memcpy(dest, &value, sizeof(T));
+    return result.ptr;
+}
+}  // namespace
+
+bool ParseState(std::string_view text, TelloState& state)
+{
+    // The state is only updated if the whole text is well formed.
+    TelloState parsed{state};
+    char* const base = reinterpret_cast<char*>(&parsed);
+    std::size_t hint{0};
+    while (!text.empty())
+    {
+        auto end = text.find(';');
+        if (end == std::string_view::npos)
+        {
+            end = text.size();
+        }
+        const auto pair = text.substr(0, end);
+        text.remove_prefix(std::min(end + 1, text.size()));
+
+        const auto colon = pair.find(':');
+        if (colon == std::string_view::npos)
+        {
+            // Only the trailing "\r\n" has no name.
+            if (pair.find_first_not_of(" \n\r\t") != std::string_view::npos)
+            {
+                return false;
+            }
+            continue;
+        }
+        const StateField* const field = FindField(pair.substr(0, colon), hint);
+        if (!field)
+        {
+            continue;
+        }
+        const char* first{pair.data() + colon + 1};
+        const char* const last{pair.data() + pair.size()};
+        for (int i = 0; i < field->count && first; ++i)
+        {
+            if (i > 0)
+            {
+                // Multiple values are separated by commas.
+                first = (first < last && *first == ',') ? first + 1 : nullptr;
+                if (!first)
+                {
+                    break;
+                }
+            }
+            // Every field is 4 bytes wide.
+            char* const dest = base + field->offset + i * sizeof(int);
+            first = field->type == StateFieldType::INT
+                        ? ParseValue<int>(first, last, dest)
+                        : ParseValue<float>(first, last, dest);
+        }
+        // Anything after the values, like "1x" or "12.5" for an integer,
+        // makes them malformed too.
+        if (first != last)
+        {
+            return false;
+        }
+    }
+    state = parsed;
+    return true;
+}
+
+double GetStateValue(const TelloState& state,
+                     const StateField& field,
+                     const int index)
+{
+    const char* const src = reinterpret_cast<const char*>(&state) +
+                            field.offset + index * sizeof(int);
+    if (field.type == StateFieldType::INT)
+    {
+        int value;
+        std::memcpy(&value, src, sizeof(value));
+        return value;
+    }
+    float value;
+    std::memcpy(&value, src, sizeof(value));
+    return value;
+}
+
+std::string FormatState(const TelloState& state)
+{
+    // Longest value plus its separator
+    std::array<char, 32> buffer;
+    std::string text;
+    text.reserve(256);
+    for (const auto& field : STATE_FIELDS)
+    {
+        text.append(field.name);
+        text.push_back(':');
+        for (int i = 0; i < field.count; ++i)
+        {
+            if (i > 0)
+            {
+                text.push_back(',');
+            }
+            const double value{GetStateValue(state, field, i)};
+            char* const first{buffer.data()};
+            char* const last{first + buffer.size()};
+            const auto result =
+                field.type == StateFieldType::INT
+                    ? std::to_chars(first, last, static_cast<int>(value))
+                    : std::to_chars(first, last, static_cast<float>(value),
+                                    std::chars_format::fixed, 2);
+            text.append(first, result.ptr);
+        }
+        text.push_back(';');
+    }
+    text.append("\r\n");
+    return text;
+}
+}  // namespace ctello
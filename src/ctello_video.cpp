@@ -0,0 +1,251 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#include "ctello_video.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include "ctello_internal.h"
+#include "spdlog/spdlog.h"
+
+namespace
+{
+// Key frames come in bursts of tens of datagrams.
+const int VIDEO_RECEIVE_BUFFER_SIZE{1024 * 1024};
+}  // namespace
+
+namespace ctello
+{
+VideoReceiver::VideoReceiver(const int local_port,
+                             const std::size_t slot_count,
+                             const std::size_t slot_size)
+    : m_local_port{local_port}, m_slots(std::max<std::size_t>(slot_count, 2))
+{
+    for (Slot& slot : m_slots)
+    {
+        slot.buffer.resize(slot_size);
+    }
+}
+
+VideoReceiver::~VideoReceiver()
+{
+    Stop();
+}
+
+bool VideoReceiver::Start()
+{
+    if (m_running)
+    {
+        return true;
+    }
+    m_sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    setsockopt(m_sockfd, SOL_SOCKET, SO_RCVBUF, &VIDEO_RECEIVE_BUFFER_SIZE,
+               sizeof(VIDEO_RECEIVE_BUFFER_SIZE));
+    const auto result = internal::BindSocketToPort(m_sockfd, m_local_port);
+    if (!result.first)
+    {
+        CTELLO_ERROR(result.second);
+        close(m_sockfd);
+        m_sockfd = -1;
+        return false;
+    }
+    m_stop_fd = eventfd(0, EFD_NONBLOCK);
+    m_event_fd = eventfd(0, EFD_NONBLOCK);
+    if (m_stop_fd == -1 || m_event_fd == -1)
+    {
+        CTELLO_ERROR("eventfd: {} ({})", errno, strerror(errno));
+        Stop();
+        return false;
+    }
+
+    m_head = 0;
+    m_tail = 0;
+    m_acquired = false;
+    m_running = true;
+    m_thread = std::thread{&VideoReceiver::Receive, this};
+    CTELLO_DEBUG("Video receiver listening on {}", m_local_port);
+    return true;
+}
+
+void VideoReceiver::Stop()
+{
+    if (m_running)
+    {
+        internal::Signal(m_stop_fd);
+        m_thread.join();
+        m_running = false;
+    }
+    for (int* const fd : {&m_sockfd, &m_stop_fd, &m_event_fd})
+    {
+        if (*fd != -1)
+        {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+bool VideoReceiver::Acquire(AccessUnit& unit,
+                            const std::chrono::milliseconds timeout)
+{
+    if (m_acquired)
+    {
+        Release();
+    }
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true)
+    {
+        const uint64_t tail{m_tail.load(std::memory_order_relaxed)};
+        if (tail != m_head.load(std::memory_order_acquire))
+        {
+            const Slot& slot{m_slots[tail % m_slots.size()]};
+            unit.data = slot.buffer.data();
+            unit.size = slot.size;
+            unit.sequence = slot.sequence;
+            unit.time = slot.time;
+            m_acquired = true;
+            return true;
+        }
+        const auto time_left = internal::TimeLeft(timeout, deadline);
+        if (!m_running || time_left.count() == 0)
+        {
+            return false;
+        }
+        pollfd fd{m_event_fd, POLLIN, 0};
+        if (poll(&fd, 1, static_cast<int>(time_left.count())) > 0)
+        {
+            internal::ClearSignal(m_event_fd);
+        }
+    }
+}
+
+void VideoReceiver::Release()
+{
+    if (!m_acquired)
+    {
+        return;
+    }
+    m_tail.store(m_tail.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+    m_acquired = false;
+}
+
+int VideoReceiver::GetPollFd() const
+{
+    return m_event_fd;
+}
+
+VideoStats VideoReceiver::GetStats() const
+{
+    VideoStats stats;
+    stats.packets = m_packets;
+    stats.bytes = m_bytes;
+    stats.access_units = m_access_units;
+    stats.dropped = m_dropped;
+    stats.oversized = m_oversized;
+    return stats;
+}
+
+void VideoReceiver::Receive()
+{
+    std::array<pollfd, 2> fds{{{m_sockfd, POLLIN, 0}, {m_stop_fd, POLLIN, 0}}};
+    // Where the rest of an access unit which doesn't fit goes
+    std::array<uint8_t, VIDEO_PACKET_SIZE> overflow;
+    bool overflowed{false};
+    Slot* slot{&m_slots[m_head.load(std::memory_order_relaxed) %
+                        m_slots.size()]};
+    slot->size = 0;
+    while (true)
+    {
+        if (poll(fds.data(), fds.size(), -1) == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            CTELLO_ERROR("poll: {} ({})", errno, strerror(errno));
+            return;
+        }
+        if (fds[1].revents)
+        {
+            return;
+        }
+
+        while (true)
+        {
+            overflowed = overflowed || slot->buffer.size() - slot->size <
+                                           VIDEO_PACKET_SIZE;
+            uint8_t* const dest{overflowed ? overflow.data()
+                                           : slot->buffer.data() + slot->size};
+            const ssize_t bytes{
+                recv(m_sockfd, dest, VIDEO_PACKET_SIZE, MSG_DONTWAIT)};
+            if (bytes < 0)
+            {
+                break;
+            }
+            m_packets.fetch_add(1, std::memory_order_relaxed);
+            m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+            if (!overflowed)
+            {
+                slot->size += bytes;
+            }
+            if (static_cast<std::size_t>(bytes) == VIDEO_PACKET_SIZE)
+            {
+                // There is more to come.
+                continue;
+            }
+
+            // The shorter datagram completes the access unit.
+            const uint64_t sequence{
+                m_access_units.fetch_add(1, std::memory_order_relaxed)};
+            if (overflowed)
+            {
+                m_oversized.fetch_add(1, std::memory_order_relaxed);
+                CTELLO_DEBUG("Access unit {} doesn't fit in {} bytes", sequence,
+                             slot->buffer.size());
+                overflowed = false;
+                slot->size = 0;
+                continue;
+            }
+            slot->sequence = sequence;
+            slot->time = std::chrono::steady_clock::now();
+            // One slot always stays with the producer.
+            const uint64_t head{m_head.load(std::memory_order_relaxed)};
+            if (head + 1 - m_tail.load(std::memory_order_acquire) >=
+                m_slots.size())
+            {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                slot->size = 0;
+                continue;
+            }
+            m_head.store(head + 1, std::memory_order_release);
+            internal::Signal(m_event_fd);
+            slot = &m_slots[(head + 1) % m_slots.size()];
+            slot->size = 0;
+        }
+    }
+}
+}  // namespace ctello
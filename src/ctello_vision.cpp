@@ -0,0 +1,321 @@
+//  CTello is a C++ library to interact with the DJI Ryze Tello Drone
+//  Copyright (C) 2020 Carlos Perez-Lopez
+//
+//  This library is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>
+//
+//  You can contact the author via carlospzlz@gmail.com
+
+#include "ctello_vision.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "ctello_internal.h"
+#include "opencv2/videoio.hpp"
+#include "spdlog/spdlog.h"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+}
+
+namespace
+{
+// How long FFmpeg may block, so the decoder notices when it's stopped.
+const int DECODE_TIMEOUT_MS{1000};
+
+// Pause before trying to open the stream again.
+const std::chrono::milliseconds REOPEN_DELAY{100};
+
+std::string ToString(const int av_error)
+{
+    char text[AV_ERROR_MAX_STRING_SIZE]{};
+    av_strerror(av_error, text, sizeof(text));
+    return text;
+}
+}  // namespace
+
+namespace ctello
+{
+H264Decoder::~H264Decoder()
+{
+    Close();
+}
+
+bool H264Decoder::Open()
+{
+    Close();
+    const AVCodec* const codec{avcodec_find_decoder(AV_CODEC_ID_H264)};
+    if (!codec)
+    {
+        CTELLO_ERROR("libavcodec has no H.264 decoder");
+        return false;
+    }
+    m_context = avcodec_alloc_context3(codec);
+    m_parser = av_parser_init(AV_CODEC_ID_H264);
+    m_packet = av_packet_alloc();
+    m_picture = av_frame_alloc();
+    if (!m_context || !m_parser || !m_packet || !m_picture)
+    {
+        CTELLO_ERROR("Couldn't allocate the H.264 decoder");
+        Close();
+        return false;
+    }
+    // Access units come whole, so the parser doesn't need to wait for the
+    // next one to find where they end.
+    m_parser->flags |= PARSER_FLAG_COMPLETE_FRAMES;
+    // Pictures are given out as soon as they are decoded, which frame
+    // threading would delay.
+    m_context->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    m_context->thread_type = FF_THREAD_SLICE;
+    const int result{avcodec_open2(m_context, codec, nullptr)};
+    if (result < 0)
+    {
+        CTELLO_ERROR("avcodec_open2: {}", ToString(result));
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void H264Decoder::Close()
+{
+    if (m_parser)
+    {
+        av_parser_close(m_parser);
+        m_parser = nullptr;
+    }
+    avcodec_free_context(&m_context);
+    av_packet_free(&m_packet);
+    av_frame_free(&m_picture);
+}
+
+bool H264Decoder::Decode(const uint8_t* data,
+                         std::size_t size,
+                         Frame& frame)
+{
+    if (!m_context)
+    {
+        CTELLO_ERROR("The H.264 decoder isn't open");
+        return false;
+    }
+    bool decoded{false};
+    while (size > 0)
+    {
+        const int used{av_parser_parse2(
+            m_parser, m_context, &m_packet->data, &m_packet->size, data,
+            static_cast<int>(size), AV_NOPTS_VALUE, AV_NOPTS_VALUE, 0)};
+        if (used < 0)
+        {
+            CTELLO_ERROR("av_parser_parse2: {}", ToString(used));
+            return false;
+        }
+        data += used;
+        size -= used;
+        // Without references, until the first key frame, pictures can't be
+        // decoded.
+        if (m_packet->size == 0 || avcodec_send_packet(m_context, m_packet) < 0)
+        {
+            continue;
+        }
+        while (avcodec_receive_frame(m_context, m_picture) == 0)
+        {
+            // The picture is referenced, not copied.
+            AVFrame* const picture{av_frame_alloc()};
+            av_frame_move_ref(picture, m_picture);
+            frame.picture = std::shared_ptr<AVFrame>{
+                picture, [](AVFrame* ref) { av_frame_free(&ref); }};
+            const auto step = static_cast<std::size_t>(picture->linesize[0]);
+            frame.image = cv::Mat{picture->height, picture->width, CV_8UC1,
+                                  picture->data[0], step};
+            decoded = true;
+        }
+    }
+    return decoded;
+}
+
+FrameSource::FrameSource(const std::string& url) : m_url{url}
+{
+}
+
+FrameSource::FrameSource(const FrameFormat format)
+    : m_format{format}, m_url{TELLO_STREAM_URL}
+{
+}
+
+FrameSource::~FrameSource()
+{
+    Stop();
+}
+
+bool FrameSource::Start()
+{
+    if (m_running)
+    {
+        return true;
+    }
+    m_event_fd = eventfd(0, EFD_NONBLOCK);
+    if (m_event_fd == -1)
+    {
+        CTELLO_ERROR("eventfd: {} ({})", errno, strerror(errno));
+        return false;
+    }
+    if (m_format == FrameFormat::LUMA)
+    {
+        m_receiver = std::make_unique<VideoReceiver>();
+        m_decoder = std::make_unique<H264Decoder>();
+        if (!m_receiver->Start() || !m_decoder->Open())
+        {
+            m_receiver.reset();
+            m_decoder.reset();
+            Stop();
+            return false;
+        }
+    }
+    m_stop = false;
+    m_running = true;
+    m_thread = m_format == FrameFormat::LUMA
+                   ? std::thread{&FrameSource::DecodeLuma, this}
+                   : std::thread{&FrameSource::DecodeBgr, this};
+    return true;
+}
+
+void FrameSource::Stop()
+{
+    if (m_running)
+    {
+        m_stop = true;
+        m_thread.join();
+        m_running = false;
+    }
+    m_receiver.reset();
+    m_decoder.reset();
+    if (m_event_fd != -1)
+    {
+        close(m_event_fd);
+        m_event_fd = -1;
+    }
+}
+
+bool FrameSource::WaitForFrame(Frame& frame,
+                               const std::chrono::milliseconds timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true)
+    {
+        if (m_frames.Update())
+        {
+            frame = m_frames.Front();
+            m_delivered.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        const auto time_left = internal::TimeLeft(timeout, deadline);
+        if (!m_running || time_left.count() == 0)
+        {
+            return false;
+        }
+        pollfd fd{m_event_fd, POLLIN, 0};
+        if (poll(&fd, 1, static_cast<int>(time_left.count())) > 0)
+        {
+            internal::ClearSignal(m_event_fd);
+        }
+    }
+}
+
+int FrameSource::GetPollFd() const
+{
+    return m_event_fd;
+}
+
+FrameStats FrameSource::GetStats() const
+{
+    FrameStats stats;
+    stats.decoded = m_decoded;
+    stats.delivered = m_delivered;
+    stats.dropped = m_dropped;
+    return stats;
+}
+
+void FrameSource::DecodeBgr()
+{
+    cv::VideoCapture capture;
+    while (!m_stop)
+    {
+        if (!capture.isOpened())
+        {
+            const bool opened{capture.open(
+                m_url, cv::CAP_FFMPEG,
+                {cv::CAP_PROP_OPEN_TIMEOUT_MSEC, DECODE_TIMEOUT_MS,
+                 cv::CAP_PROP_READ_TIMEOUT_MSEC, DECODE_TIMEOUT_MS})};
+            if (!opened)
+            {
+                CTELLO_DEBUG("Waiting for the stream at {}", m_url);
+                std::this_thread::sleep_for(REOPEN_DELAY);
+                continue;
+            }
+            CTELLO_INFO("Decoding {}", m_url);
+        }
+
+        // Decoding in place reuses the buffer of a frame dropped or already
+        // released by the consumer.
+        Frame& frame{m_frames.Back()};
+        if (!capture.read(frame.image) || frame.image.empty())
+        {
+            CTELLO_WARN("Lost the stream at {}", m_url);
+            capture.release();
+            continue;
+        }
+        Publish();
+    }
+}
+
+void FrameSource::DecodeLuma()
+{
+    CTELLO_INFO("Decoding luma from port {}", LOCAL_SERVER_VIDEO_PORT);
+    const std::chrono::milliseconds timeout{DECODE_TIMEOUT_MS};
+    AccessUnit unit;
+    while (!m_stop)
+    {
+        if (!m_receiver->Acquire(unit, timeout))
+        {
+            continue;
+        }
+        // Taking the place of a picture dropped or already released by the
+        // consumer, which goes back to the decoder.
+        const bool decoded{
+            m_decoder->Decode(unit.data, unit.size, m_frames.Back())};
+        m_receiver->Release();
+        if (decoded)
+        {
+            Publish();
+        }
+    }
+}
+
+void FrameSource::Publish()
+{
+    Frame& frame{m_frames.Back()};
+    frame.sequence = m_decoded.fetch_add(1, std::memory_order_relaxed);
+    frame.time = std::chrono::steady_clock::now();
+    if (!m_frames.Publish())
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    internal::Signal(m_event_fd);
+}
+}  // namespace ctello